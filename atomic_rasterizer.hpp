@@ -0,0 +1,142 @@
+#pragma once
+
+#include "parallel.hpp"
+#include "rasterization.hpp"
+#include "tga_color.hpp"
+#include "tgaimage.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Depth and color of every pixel packed into one 64-bit word: an order preserving key of the depth in the high half
+// and the BGRA color in the low half. Depth grows towards the viewer, so the nearer fragment is always the larger
+// word and the depth test plus the write become a single atomic max that any number of threads can race on.
+// Equal depths are settled by the color bits, so the result doesn't depend on which thread got there first.
+class AtomicFramebuffer {
+public:
+  AtomicFramebuffer(int width, int height)
+    : width(width)
+    , height(height)
+    , pixels(width * height) {
+    clear();
+  }
+
+  int get_width() const { return width; }
+  int get_height() const { return height; }
+
+  void clear() {
+    for (auto& pixel : pixels)
+      pixel.store(EMPTY, std::memory_order_relaxed);
+  }
+
+  // Cheap early out before shading, a fragment that fails it can't win the write either.
+  // Equal depth passes, the color bits still decide those.
+  bool nearer(int x, int y, float_t depth) const {
+    return depth_key(depth) >= uint32_t(pixels[x + y * width].load(std::memory_order_relaxed) >> 32);
+  }
+
+  void write(int x, int y, float_t depth, TGAColor color) {
+    const uint64_t packed = uint64_t(depth_key(depth)) << 32 | color.val;
+    std::atomic<uint64_t>& pixel = pixels[x + y * width];
+    uint64_t current = pixel.load(std::memory_order_relaxed);
+    while (current < packed && !pixel.compare_exchange_weak(current, packed, std::memory_order_relaxed))
+      ;
+  }
+
+  // Copies every drawn pixel into `image` and the depth of all of them into `z_buffer`, pixels nothing was drawn
+  // to keep their color and get the cleared depth of the other rasterizers
+  void resolve(TGAImage& image, std::vector<float_t>& z_buffer) const {
+    parallel_for(height, [&](size_t y) {
+      for (int x = 0; x < width; ++x) {
+        const size_t i = x + y * width;
+        const uint64_t packed = pixels[i].load(std::memory_order_relaxed);
+        z_buffer[i] = key_depth(uint32_t(packed >> 32));
+        if (packed != EMPTY)
+          image.set(x, y, TGAColor(uint32_t(packed)));
+      }
+    });
+  }
+
+  // Float bits reordered so unsigned comparison agrees with float comparison: positives get the sign bit set,
+  // negatives are inverted so their magnitude counts down
+  static uint32_t depth_key(float_t depth) {
+    const uint32_t bits = std::bit_cast<uint32_t>(depth);
+    return bits & 0x8000'0000u ? ~bits : bits | 0x8000'0000u;
+  }
+
+  static float_t key_depth(uint32_t key) {
+    return std::bit_cast<float_t>(key & 0x8000'0000u ? key & 0x7FFF'FFFFu : ~key);
+  }
+
+private:
+  static constexpr uint64_t EMPTY = uint64_t(0x0080'0000u) << 32; // depth_key(-max), no color
+
+  int width;
+  int height;
+  std::vector<std::atomic<uint64_t>> pixels;
+};
+
+// Sort-last rasterizer: submitted triangles are split into contiguous ranges and every range is rasterized on its own
+// thread straight into an AtomicFramebuffer. No binning pass and no per tile bookkeeping, which pays off when a frame
+// is many small triangles with little overdraw; TileRasterizer wins when triangles are large or overlap a lot.
+class AtomicRasterizer {
+public:
+  // triangles per range handed to a thread
+  static constexpr size_t BATCH_SIZE = 256;
+
+  struct Triangle {
+    std::array<glm::vec3, 3> screen_coords;
+    std::array<glm::vec2, 3> texcoords;
+    float_t light_intensity;
+  };
+
+  AtomicRasterizer(int width, int height)
+    : width(width)
+    , height(height) {
+  }
+
+  void submit(const std::array<glm::vec3, 3>& screen_coords, const std::array<glm::vec2, 3>& texcoords, float_t light_intensity) {
+    triangles.push_back(Triangle{ screen_coords, texcoords, light_intensity });
+  }
+
+  // Rasterizes everything submitted so far into `framebuffer`, call AtomicFramebuffer::resolve to get an image
+  void flush(AtomicFramebuffer& framebuffer, TGAImage& texture) {
+    const size_t batches = (triangles.size() + BATCH_SIZE - 1) / BATCH_SIZE;
+    parallel_for(batches, [&](size_t batch) {
+      const size_t end = std::min(triangles.size(), (batch + 1) * BATCH_SIZE);
+      for (size_t i = batch * BATCH_SIZE; i < end; ++i)
+        raster(triangles[i], framebuffer, texture);
+    });
+    triangles.clear();
+  }
+
+private:
+  void raster(const Triangle& t, AtomicFramebuffer& framebuffer, TGAImage& texture) {
+    auto& [a, b, c] = t.screen_coords;
+    const glm::vec2 clamp_min{ 0, 0 };
+    const glm::vec2 clamp_max{ width - 1, height - 1 };
+    const TriangleSetup setup = setup_triangle(t.screen_coords, clamp_min, clamp_max);
+    if (setup.area <= 1e-2)
+      return;
+
+    // the walk of the other rasterizers, so a pixel gets the coverage and depth they would give it
+    walk_triangle(setup, [&](int32_t x, int32_t y, glm::vec3 bc) {
+      const float_t z = a.z * bc.x + b.z * bc.y + c.z * bc.z;
+      if (!framebuffer.nearer(x, y, z))
+        return;
+      framebuffer.write(x, y, z, shade_textured(texture, t.texcoords, bc, t.light_intensity));
+    });
+  }
+
+  int width;
+  int height;
+  std::vector<Triangle> triangles;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+
+// Best wall time of `repeats` runs of `fn` in milliseconds. The best run is the one least disturbed by the rest of
+// the machine, which is what a comparison of two implementations wants.
+template<class Fn>
+double best_ms(int repeats, Fn&& fn) {
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < repeats; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  return best;
+}
+
+inline double mb_per_s(size_t bytes, double ms) {
+  return bytes / (ms * 1e3);
+}
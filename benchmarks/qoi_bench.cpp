@@ -0,0 +1,62 @@
+// QOI against the RLE TGA writer and reader: file size and throughput on every TGA shipped in ./assets, as stored
+// and converted to RGBA. Writing to /dev/null times the encoders alone, the sizes come from real files.
+#include "bench.hpp"
+#include "../tgaimage.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static void compare(const std::string& name, TGAImage& image) {
+  const std::filesystem::path directory = std::filesystem::temp_directory_path();
+  const std::string tga = (directory / "qoi_bench.tga").string();
+  const std::string qoi = (directory / "qoi_bench.qoi").string();
+  image.write_tga_file(tga.c_str());
+  image.write_qoi_file(qoi.c_str());
+  const size_t bytes = size_t(image.get_width()) * image.get_height() * image.get_bytespp();
+
+  TGAImage back;
+  const double write_tga = best_ms(15, [&] { image.write_tga_file("/dev/null"); });
+  const double write_qoi = best_ms(15, [&] { image.write_qoi_file("/dev/null"); });
+  const double read_tga = best_ms(15, [&] { back.read_tga_file(tga.c_str()); });
+  const double read_qoi = best_ms(15, [&] { back.read_qoi_file(qoi.c_str()); });
+
+  std::printf("%s %dx%d/%d, %zu KiB raw\n", name.c_str(), image.get_width(), image.get_height(), image.get_bytespp() * 8, bytes / 1024);
+  std::printf("  RLE TGA %6zu KiB  write %5.0f MB/s  read %5.0f MB/s\n", size_t(std::filesystem::file_size(tga)) / 1024,
+    mb_per_s(bytes, write_tga), mb_per_s(bytes, read_tga));
+  std::printf("  QOI     %6zu KiB  write %5.0f MB/s  read %5.0f MB/s  (write %.2fx, read %.2fx of RLE TGA)\n",
+    size_t(std::filesystem::file_size(qoi)) / 1024, mb_per_s(bytes, write_qoi), mb_per_s(bytes, read_qoi), write_tga / write_qoi,
+    read_tga / read_qoi);
+  std::filesystem::remove(tga);
+  std::filesystem::remove(qoi);
+}
+
+int main() {
+  std::vector<std::string> shipped;
+  for (const auto& entry : std::filesystem::directory_iterator("./assets"))
+    if (entry.path().extension() == ".tga")
+      shipped.push_back(entry.path().string());
+
+  // the readers report every image they read
+  std::streambuf* log = std::cerr.rdbuf(nullptr);
+  for (const std::string& filename : shipped) {
+    TGAImage image;
+    if (!image.read_tga_file(filename.c_str()))
+      continue;
+    compare(filename, image);
+
+    TGAImage rgba(image.get_width(), image.get_height(), TGAImage::RGBA, image.get_origin());
+    for (int y = 0; y < image.get_height(); ++y) {
+      for (int x = 0; x < image.get_width(); ++x) {
+        TGAColor color = image.get(x, y);
+        color.a = 255;
+        rgba.set(x, y, color);
+      }
+    }
+    compare(filename + " as RGBA", rgba);
+  }
+  std::cerr.rdbuf(log);
+}
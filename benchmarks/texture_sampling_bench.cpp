@@ -0,0 +1,52 @@
+// Bilinear sampling of the african_head diffuse map from LINEAR and TILED Texture2D storage while the map is rotated
+// on screen: at 0 degrees a screen row walks along u (the LINEAR layout's rows), at 90 degrees along v
+#include "bench.hpp"
+#include "../texture.hpp"
+#include "../tgaimage.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+int main() {
+  TGAImage diffuse;
+  if (!diffuse.read_tga_file("./assets/african_head_diffuse.tga"))
+    return EXIT_FAILURE;
+  const Texture2D linear(diffuse, Texture2D::LINEAR);
+  const Texture2D tiled(diffuse, Texture2D::TILED);
+
+  // one sample per texel of level 0, so nothing is served by a smaller mip
+  const int size = linear.get_width();
+  for (int degrees : { 0, 30, 45, 90 }) {
+    const float_t angle = glm::radians(float_t(degrees));
+    const glm::vec2 step_x = glm::vec2(std::cos(angle), std::sin(angle)) / float_t(size);
+    const glm::vec2 step_y = glm::vec2(-std::sin(angle), std::cos(angle)) / float_t(size);
+    const glm::vec2 origin = glm::vec2(0.5f) - (step_x + step_y) * (size / 2.0f);
+
+    // bilinear samples, then the nearest texel alone where the layout is a larger share of the cost
+    for (bool filtered : { true, false }) {
+      uint32_t checksums[2] = {};
+      double ms[2];
+      for (int i = 0; i < 2; ++i) {
+        const Texture2D& texture = i ? tiled : linear;
+        ms[i] = best_ms(5, [&] {
+          uint32_t checksum = 0;
+          for (int y = 0; y < size; ++y) {
+            glm::vec2 uv = origin + step_y * float_t(y);
+            for (int x = 0; x < size; ++x, uv += step_x)
+              checksum += filtered ? texture.sample(uv, 0).val : texture.fetch(0, int(uv.x * size), int(uv.y * size)).val;
+          }
+          checksums[i] = checksum;
+        });
+      }
+
+      const double samples = double(size) * size;
+      std::printf("%2d degrees %-8s: linear %6.2f ms (%4.0f Msamples/s), tiled %6.2f ms (%4.0f Msamples/s), tiled %.2fx%s\n",
+        degrees, filtered ? "bilinear" : "nearest", ms[0], samples / (ms[0] * 1e3), ms[1], samples / (ms[1] * 1e3), ms[0] / ms[1],
+        checksums[0] == checksums[1] ? "" : ", RESULTS DIFFER");
+    }
+  }
+}
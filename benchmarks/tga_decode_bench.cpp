@@ -0,0 +1,33 @@
+// TGAImage::read_tga_file (mapped file, load_rle_data) against the old stream decoder it replaced, on the shipped
+// RLE diffuse map and on the same picture written raw
+#include "bench.hpp"
+#include "../tests/tga_reference.hpp"
+#include "../tgaimage.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+int main() {
+  const std::string rle = "./assets/african_head_diffuse.tga";
+  const std::string raw = (std::filesystem::temp_directory_path() / "tga_decode_bench_raw.tga").string();
+  TGAImage source;
+  if (!source.read_tga_file(rle.c_str()) || !source.write_tga_file(raw.c_str(), false))
+    return EXIT_FAILURE;
+  const size_t bytes = size_t(source.get_width()) * source.get_height() * source.get_bytespp();
+
+  // read_tga_file reports every image it reads
+  std::streambuf* log = std::cerr.rdbuf(nullptr);
+  for (const std::string& filename : { rle, raw }) {
+    TGAImage image;
+    ReferenceTGA reference;
+    const double mapped = best_ms(20, [&] { image.read_tga_file(filename.c_str()); });
+    const double streamed = best_ms(20, [&] { read_reference_tga(filename.c_str(), reference); });
+    std::printf("%s (%zu KiB decoded): read_tga_file %.2f ms (%.0f MB/s), stream decoder %.2f ms (%.0f MB/s), %.1fx\n", filename.c_str(),
+      bytes / 1024, mapped, mb_per_s(bytes, mapped), streamed, mb_per_s(bytes, streamed), streamed / mapped);
+  }
+  std::cerr.rdbuf(log);
+  std::filesystem::remove(raw);
+}
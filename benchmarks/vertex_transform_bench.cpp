@@ -0,0 +1,54 @@
+// transform_vertices on structure of arrays streams against a glm transform and clip_to_screen per vertex
+#include "bench.hpp"
+#include "../vertex_processing.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+int main() {
+  // a perspective-ish matrix, so w varies per vertex like in the lessons
+  glm::mat4 mvp(1.0f);
+  mvp[3][2] = -3.0f;
+  mvp[2][3] = 1.0f;
+  mvp[3][3] = 0.5f;
+  const Viewport viewport = make_viewport(800, 800);
+
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float_t> coordinate(-1, 1);
+  for (size_t count : { size_t(1) << 20, size_t(1) << 22 }) {
+    PositionStream positions;
+    positions.x.resize(count);
+    positions.y.resize(count);
+    positions.z.resize(count);
+    std::vector<glm::vec3> vertices(count);
+    for (size_t i = 0; i < count; ++i) {
+      vertices[i] = glm::vec3(coordinate(random), coordinate(random), coordinate(random));
+      positions.x[i] = vertices[i].x;
+      positions.y[i] = vertices[i].y;
+      positions.z[i] = vertices[i].z;
+    }
+
+    std::vector<glm::vec4> clip(count);
+    std::vector<glm::vec3> screen(count);
+    const double per_vertex = best_ms(10, [&] {
+      for (size_t i = 0; i < count; ++i) {
+        clip[i] = mvp * glm::vec4(vertices[i], 1.0f);
+        screen[i] = clip_to_screen(clip[i], viewport);
+      }
+    });
+
+    VertexStream stream;
+    const double batched = best_ms(10, [&] { transform_vertices(positions, mvp, viewport, stream); });
+
+    float_t max_error = 0;
+    for (size_t i = 0; i < count; ++i)
+      max_error = std::max(max_error, std::abs(stream.screen(i).x - screen[i].x) + std::abs(stream.screen(i).y - screen[i].y));
+
+    std::printf("%zu vertices: glm per vertex %.2f ms (%.0f Mvertices/s), transform_vertices %.2f ms (%.0f Mvertices/s), %.2fx, max screen difference %g px\n",
+      count, per_vertex, count / (per_vertex * 1e3), batched, count / (batched * 1e3), per_vertex / batched, max_error);
+  }
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// BC1 (DXT1) blocks: a 4x4 texel block in 64 bits, two RGB565 endpoints and a 2-bit palette index per texel.
+// Texels are BGRA8 words like TGAColor::val, block texel i is at (i % 4, i / 4). Alpha isn't kept, every encoded
+// texel decodes opaque.
+constexpr int BC1_BLOCK_SIZE = 4;
+// least squares passes over the endpoints of a block in encode_bc1_block
+constexpr int BC1_REFINE_ITERATIONS = 2;
+
+inline uint32_t bc1_expand_565(uint16_t color) {
+  const uint32_t r = color >> 11;
+  const uint32_t g = (color >> 5) & 0x3F;
+  const uint32_t b = color & 0x1F;
+  return 0xFF00'0000u | ((r << 3) | (r >> 2)) << 16 | ((g << 2) | (g >> 4)) << 8 | ((b << 3) | (b >> 2));
+}
+
+inline uint16_t bc1_quantize_565(glm::vec3 rgb) {
+  rgb = glm::clamp(rgb, 0.0f, 255.0f);
+  const uint32_t r = uint32_t(rgb.r * 31 / 255 + 0.5f);
+  const uint32_t g = uint32_t(rgb.g * 63 / 255 + 0.5f);
+  const uint32_t b = uint32_t(rgb.b * 31 / 255 + 0.5f);
+  return uint16_t(r << 11 | g << 5 | b);
+}
+
+// The four palette entries of a block, as the hardware decodes them: two interpolated colors when the first
+// endpoint is the larger, otherwise one midpoint and transparent black
+inline std::array<uint32_t, 4> bc1_palette(uint16_t color0, uint16_t color1) {
+  const uint32_t c0 = bc1_expand_565(color0);
+  const uint32_t c1 = bc1_expand_565(color1);
+  std::array<uint32_t, 4> palette{ c0, c1, 0, 0 };
+  for (int shift = 0; shift < 24; shift += 8) {
+    const uint32_t a = (c0 >> shift) & 0xFF;
+    const uint32_t b = (c1 >> shift) & 0xFF;
+    if (color0 > color1) {
+      palette[2] |= ((2 * a + b) / 3) << shift;
+      palette[3] |= ((a + 2 * b) / 3) << shift;
+    } else {
+      palette[2] |= ((a + b) / 2) << shift;
+    }
+  }
+  palette[2] |= 0xFF00'0000u;
+  if (color0 > color1)
+    palette[3] |= 0xFF00'0000u;
+  return palette;
+}
+
+inline void decode_bc1_block(uint64_t block, uint32_t* texels) {
+  const std::array<uint32_t, 4> palette = bc1_palette(uint16_t(block), uint16_t(block >> 16));
+  uint32_t indices = uint32_t(block >> 32);
+  for (int i = 0; i < 16; ++i, indices >>= 2)
+    texels[i] = palette[indices & 3];
+}
+
+// Nearest four color mode palette entry of every texel, `error` is the summed squared distance to them
+inline uint32_t bc1_indices(const std::array<glm::vec3, 16>& colors, uint16_t color0, uint16_t color1, float_t& error) {
+  const std::array<uint32_t, 4> palette = bc1_palette(color0, color1);
+  std::array<glm::vec3, 4> entries;
+  for (int k = 0; k < 4; ++k)
+    entries[k] = glm::vec3((palette[k] >> 16) & 0xFF, (palette[k] >> 8) & 0xFF, palette[k] & 0xFF);
+
+  uint32_t indices = 0;
+  error = 0;
+  for (int i = 0; i < 16; ++i) {
+    uint32_t best = 0;
+    float_t best_distance = std::numeric_limits<float_t>::max();
+    for (uint32_t k = 0; k < 4; ++k) {
+      const glm::vec3 d = colors[i] - entries[k];
+      const float_t distance = glm::dot(d, d);
+      if (distance < best_distance) {
+        best_distance = distance;
+        best = k;
+      }
+    }
+    indices |= best << (2 * i);
+    error += best_distance;
+  }
+  return indices;
+}
+
+// Endpoints start as the extremes of the block along its principal axis and are then refit by least squares to
+// the indices they give. Always emits the four color mode.
+inline uint64_t encode_bc1_block(const uint32_t* texels) {
+  std::array<glm::vec3, 16> colors;
+  glm::vec3 mean{ 0 };
+  for (int i = 0; i < 16; ++i) {
+    const uint32_t t = texels[i];
+    colors[i] = glm::vec3((t >> 16) & 0xFF, (t >> 8) & 0xFF, t & 0xFF);
+    mean += colors[i];
+  }
+  mean /= 16.0f;
+
+  float_t cov[6] = {};
+  for (const glm::vec3& c : colors) {
+    const glm::vec3 d = c - mean;
+    cov[0] += d.r * d.r;
+    cov[1] += d.r * d.g;
+    cov[2] += d.r * d.b;
+    cov[3] += d.g * d.g;
+    cov[4] += d.g * d.b;
+    cov[5] += d.b * d.b;
+  }
+  // power iteration, a handful of steps is plenty for a 3x3 matrix
+  glm::vec3 axis{ 1, 1, 1 };
+  for (int i = 0; i < 8; ++i) {
+    axis = glm::vec3(cov[0] * axis.r + cov[1] * axis.g + cov[2] * axis.b, cov[1] * axis.r + cov[3] * axis.g + cov[4] * axis.b,
+      cov[2] * axis.r + cov[4] * axis.g + cov[5] * axis.b);
+    const float_t length = std::max({ std::abs(axis.r), std::abs(axis.g), std::abs(axis.b) });
+    if (length == 0)
+      break;
+    axis /= length;
+  }
+
+  glm::vec3 lo = mean;
+  glm::vec3 hi = mean;
+  float_t lo_t = 0;
+  float_t hi_t = 0;
+  for (const glm::vec3& c : colors) {
+    const float_t t = glm::dot(c - mean, axis);
+    if (t < lo_t) {
+      lo_t = t;
+      lo = c;
+    }
+    if (t > hi_t) {
+      hi_t = t;
+      hi = c;
+    }
+  }
+
+  uint16_t color0 = bc1_quantize_565(hi);
+  uint16_t color1 = bc1_quantize_565(lo);
+  if (color0 < color1)
+    std::swap(color0, color1);
+  if (color0 == color1)
+    return color0 | uint64_t(color1) << 16;
+
+  float_t error;
+  uint32_t indices = bc1_indices(colors, color0, color1, error);
+
+  // least squares endpoints for those indices, kept while they still improve on the previous ones after quantization
+  constexpr float_t weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+  for (int iteration = 0; iteration < BC1_REFINE_ITERATIONS; ++iteration) {
+    float_t aa = 0, ab = 0, bb = 0;
+    glm::vec3 ax{ 0 }, bx{ 0 };
+    for (int i = 0; i < 16; ++i) {
+      const float_t w = weights[(indices >> (2 * i)) & 3];
+      aa += w * w;
+      ab += w * (1 - w);
+      bb += (1 - w) * (1 - w);
+      ax += w * colors[i];
+      bx += (1 - w) * colors[i];
+    }
+    const float_t det = aa * bb - ab * ab;
+    if (std::abs(det) <= 1e-3f)
+      break;
+    uint16_t refined0 = bc1_quantize_565((bb * ax - ab * bx) / det);
+    uint16_t refined1 = bc1_quantize_565((aa * bx - ab * ax) / det);
+    if (refined0 < refined1)
+      std::swap(refined0, refined1);
+    if (refined0 == refined1)
+      break;
+    float_t refined_error;
+    const uint32_t refined_indices = bc1_indices(colors, refined0, refined1, refined_error);
+    if (refined_error >= error)
+      break;
+    color0 = refined0;
+    color1 = refined1;
+    indices = refined_indices;
+    error = refined_error;
+  }
+  return color0 | uint64_t(color1) << 16 | uint64_t(indices) << 32;
+}
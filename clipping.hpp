@@ -0,0 +1,99 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Clip space vertex with the attributes that get interpolated along clipped edges
+struct ClipVertex {
+  glm::vec4 position;
+  glm::vec2 texcoord;
+};
+
+// A triangle clipped by N planes gains at most one vertex per plane
+constexpr size_t MAX_CLIP_POLYGON = 3 + 5;
+
+struct ClipPolygon {
+  std::array<ClipVertex, MAX_CLIP_POLYGON> vertices;
+  size_t size = 0;
+  // false when the input triangle came through untouched
+  bool clipped = false;
+};
+
+// Guard band in units of w: only triangles reaching this far outside of the viewport are clipped against the
+// side planes, everything closer is left to the rasterizer's bounding box clamp. Keeps screen coordinates well
+// inside the range of the 28.4 fixed point setup.
+constexpr float_t GUARD_BAND = 16.0f;
+
+// Sutherland-Hodgman against the plane `dot(plane, position) >= 0`, attributes are interpolated in clip space
+// so they stay perspective correct
+inline ClipPolygon clip_polygon(const ClipPolygon& in, glm::vec4 plane) {
+  ClipPolygon out{};
+  for (size_t i = 0; i < in.size; ++i) {
+    const ClipVertex& a = in.vertices[i];
+    const ClipVertex& b = in.vertices[(i + 1) % in.size];
+    const float_t da = glm::dot(plane, a.position);
+    const float_t db = glm::dot(plane, b.position);
+
+    if (da >= 0)
+      out.vertices[out.size++] = a;
+    if ((da >= 0) != (db >= 0)) {
+      const float_t t = da / (da - db);
+      out.vertices[out.size++] = ClipVertex{ glm::mix(a.position, b.position, t), glm::mix(a.texcoord, b.texcoord, t) };
+    }
+  }
+  return out;
+}
+
+// Clips a clip space triangle (D3D style: 0 <= z <= w) against the near plane and, when it leaves the guard band,
+// against the side planes. Triangles that are completely outside of any side plane are rejected right away.
+// The result is a convex polygon ready to be fanned into triangles, empty when nothing is visible.
+inline ClipPolygon clip_triangle(const std::array<ClipVertex, 3>& triangle) {
+  // outcodes against the side planes and the guard band planes, plus the near plane
+  uint32_t all_outside = 0x1F;
+  uint32_t any_outside = 0;
+  for (const ClipVertex& v : triangle) {
+    const glm::vec4& p = v.position;
+    uint32_t viewport = 0;
+    viewport |= (p.x < -p.w) << 0;
+    viewport |= (p.x > p.w) << 1;
+    viewport |= (p.y < -p.w) << 2;
+    viewport |= (p.y > p.w) << 3;
+    viewport |= (p.z < 0) << 4;
+    all_outside &= viewport;
+
+    uint32_t guard_band = 0;
+    guard_band |= (p.x < -GUARD_BAND * p.w) << 0;
+    guard_band |= (p.x > GUARD_BAND * p.w) << 1;
+    guard_band |= (p.y < -GUARD_BAND * p.w) << 2;
+    guard_band |= (p.y > GUARD_BAND * p.w) << 3;
+    guard_band |= (p.z < 0) << 4;
+    any_outside |= guard_band;
+  }
+
+  ClipPolygon polygon{};
+  if (all_outside)
+    return polygon;
+
+  polygon.size = 3;
+  std::copy(triangle.begin(), triangle.end(), polygon.vertices.begin());
+  if (!any_outside)
+    return polygon;
+
+  polygon.clipped = true;
+  const std::array<glm::vec4, 5> planes{
+    glm::vec4(1, 0, 0, GUARD_BAND),
+    glm::vec4(-1, 0, 0, GUARD_BAND),
+    glm::vec4(0, 1, 0, GUARD_BAND),
+    glm::vec4(0, -1, 0, GUARD_BAND),
+    glm::vec4(0, 0, 1, 0),
+  };
+  for (size_t i = 0; i < planes.size() && polygon.size > 0; ++i) {
+    if (any_outside & (1u << i))
+      polygon = clip_polygon(polygon, planes[i]);
+  }
+  return polygon;
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "tgaimage.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Writes a sequence of frames as one uncompressed stream to a file descriptor, so a render can be piped straight into
+// an encoder without a file per frame, e.g.
+//   ./main --y4m | ffmpeg -i - out.mp4
+//   ./main --ppm | ffmpeg -f image2pipe -c:v ppm -i - out.mp4
+// PPM is a concatenation of P6 images (P5 for GRAYSCALE), Y4M one header followed by 4:2:0 frames in BT.601 studio
+// range. Alpha is dropped. Rows are walked top to bottom through the frame's origin while converting, so nothing is
+// flipped in place.
+// A pipe whose reader went away raises SIGPIPE; ignore it to see the failure as a false from write() instead.
+class FrameStream {
+public:
+  enum Format {
+    PPM,
+    Y4M
+  };
+
+  explicit FrameStream(Format format, int fps = 25)
+    : format(format), fps(fps) {
+  }
+
+  FrameStream(const FrameStream&) = delete;
+  FrameStream& operator=(const FrameStream&) = delete;
+
+  ~FrameStream() { close(); }
+
+  // Creates or truncates `filename` (a named pipe works too), "-" is stdout
+  bool open(const char* filename) {
+    if (!strcmp(filename, "-")) {
+      open(STDOUT_FILENO);
+      return true;
+    }
+    close();
+    const int file = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+      std::cerr << "can't open file " << filename << "\n";
+      return false;
+    }
+    open(file);
+    owned = true;
+    return true;
+  }
+
+  // Streams to a descriptor that is already open, e.g. the write end of a pipe. It's left open on close().
+  void open(int descriptor) {
+    close();
+    fd = descriptor;
+    width = height = 0;
+    failed = false;
+  }
+
+  void close() {
+    if (owned)
+      ::close(fd);
+    fd = -1;
+    owned = false;
+  }
+
+  // Appends one frame. Every frame of a Y4M stream must have the size of the first one.
+  // False once anything failed, the stream is unusable from then on.
+  bool write(TGAImage& frame) {
+    if (fd < 0 || failed)
+      return false;
+    const int w = frame.get_width();
+    const int h = frame.get_height();
+    if (format == Y4M && width && (w != width || h != height)) {
+      std::cerr << "all frames of a y4m stream need the same size\n";
+      failed = true;
+      return false;
+    }
+    if (format == Y4M && !width) {
+      const std::string header = "YUV4MPEG2 W" + std::to_string(w) + " H" + std::to_string(h) + " F" + std::to_string(fps)
+        + ":1 Ip A1:1 C420jpeg\n";
+      if (!write_all(reinterpret_cast<const unsigned char*>(header.data()), header.size()))
+        return false;
+    }
+    width = w;
+    height = h;
+
+    if (format == PPM)
+      encode_ppm(frame);
+    else
+      encode_y4m(frame);
+    return write_all(buffer.data(), buffer.size());
+  }
+
+private:
+  // Row y counted from the top of the picture
+  const unsigned char* top_down_row(TGAImage& frame, int y) const {
+    return frame.buffer() + size_t(frame.row_from_bottom(height - 1 - y)) * width * frame.get_bytespp();
+  }
+
+  void encode_ppm(TGAImage& frame) {
+    const int bytespp = frame.get_bytespp();
+    const int channels = bytespp == TGAImage::GRAYSCALE ? 1 : 3;
+    char header[64];
+    const int header_size = snprintf(header, sizeof(header), "P%d\n%d %d\n255\n", channels == 1 ? 5 : 6, width, height);
+    buffer.resize(header_size + size_t(width) * height * channels);
+    memcpy(buffer.data(), header, header_size);
+    unsigned char* dst = buffer.data() + header_size;
+    for (int y = 0; y < height; ++y) {
+      const unsigned char* src = top_down_row(frame, y);
+      if (channels == 1) {
+        memcpy(dst, src, width);
+        dst += width;
+        continue;
+      }
+      // BGR(A) to RGB
+      for (int x = 0; x < width; ++x, src += bytespp, dst += 3) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+      }
+    }
+  }
+
+  // Full resolution luma and one chroma sample per 2x2 block (fewer at odd edges) from the block's average color
+  void encode_y4m(TGAImage& frame) {
+    static const char frame_header[] = "FRAME\n";
+    const int bytespp = frame.get_bytespp();
+    const int chroma_width = (width + 1) / 2;
+    const int chroma_height = (height + 1) / 2;
+    const size_t luma_size = size_t(width) * height;
+    const size_t chroma_size = size_t(chroma_width) * chroma_height;
+    buffer.resize(sizeof(frame_header) - 1 + luma_size + 2 * chroma_size);
+    memcpy(buffer.data(), frame_header, sizeof(frame_header) - 1);
+    unsigned char* luma = buffer.data() + sizeof(frame_header) - 1;
+    unsigned char* cb = luma + luma_size;
+    unsigned char* cr = cb + chroma_size;
+
+    auto rgb = [&](const unsigned char* p, int& r, int& g, int& b) {
+      if (bytespp == TGAImage::GRAYSCALE) {
+        r = g = b = p[0];
+      } else {
+        r = p[2];
+        g = p[1];
+        b = p[0];
+      }
+    };
+
+    for (int y = 0; y < height; y += 2) {
+      const unsigned char* rows[2] = { top_down_row(frame, y), top_down_row(frame, std::min(y + 1, height - 1)) };
+      const int row_count = y + 1 < height ? 2 : 1;
+      for (int x = 0; x < width; x += 2) {
+        const int column_count = x + 1 < width ? 2 : 1;
+        int r_sum = 0, g_sum = 0, b_sum = 0;
+        for (int j = 0; j < row_count; ++j) {
+          for (int i = 0; i < column_count; ++i) {
+            int r, g, b;
+            rgb(rows[j] + size_t(x + i) * bytespp, r, g, b);
+            luma[size_t(y + j) * width + x + i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+            r_sum += r;
+            g_sum += g;
+            b_sum += b;
+          }
+        }
+        const int count = row_count * column_count;
+        const int r = (r_sum + count / 2) / count;
+        const int g = (g_sum + count / 2) / count;
+        const int b = (b_sum + count / 2) / count;
+        const size_t chroma = size_t(y / 2) * chroma_width + x / 2;
+        cb[chroma] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+        cr[chroma] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+      }
+    }
+  }
+
+  bool write_all(const unsigned char* bytes, size_t size) {
+    while (size) {
+      const ssize_t written = ::write(fd, bytes, size);
+      if (written < 0) {
+        if (errno == EINTR)
+          continue;
+        std::cerr << "can't write the frame stream: " << strerror(errno) << "\n";
+        failed = true;
+        return false;
+      }
+      bytes += written;
+      size -= written;
+    }
+    return true;
+  }
+
+  Format format;
+  int fps;
+  int fd = -1;
+  bool owned = false;
+  bool failed = false;
+  // size of the stream's frames, 0 before the first one
+  int width = 0;
+  int height = 0;
+  // one encoded frame, reused from frame to frame
+  std::vector<unsigned char> buffer;
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "tgaimage.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Output stage for animations and batch jobs: frames are rendered into buffers from a small pool and handed to a
+// background thread that encodes and writes them, so rendering the next frame overlaps the disk I/O of the
+// previous ones. Once every buffer is queued for writing acquire() blocks, which bounds memory and holds the
+// renderer back when the disk falls behind.
+// Misuse throws std::logic_error instead of deadlocking: submitting an image that isn't a buffer currently handed
+// out by acquire(), or calling acquire() or submit() after finish().
+class FrameWriter {
+public:
+  FrameWriter(int width, int height, int bytespp, size_t buffer_count = 2, bool rle = true)
+    : rle(rle) {
+    buffers.reserve(buffer_count);
+    acquired.assign(buffer_count, false);
+    for (size_t i = 0; i < buffer_count; ++i) {
+      buffers.emplace_back(width, height, bytespp, TGAImage::BOTTOM_LEFT);
+      idle.push_back(i);
+    }
+    worker = std::thread([this]() { run(); });
+  }
+
+  FrameWriter(const FrameWriter&) = delete;
+  FrameWriter& operator=(const FrameWriter&) = delete;
+
+  ~FrameWriter() { finish(); }
+
+  // A cleared buffer to render the next frame into (origin at the left bottom), waits while all of them are still
+  // queued for writing
+  TGAImage& acquire() {
+    size_t index;
+    {
+      std::unique_lock lock(mutex);
+      available.wait(lock, [&]() { return stopping || !idle.empty(); });
+      if (stopping)
+        throw std::logic_error("FrameWriter::acquire() after finish()");
+      index = idle.front();
+      idle.pop_front();
+      acquired[index] = true;
+    }
+    buffers[index].clear();
+    return buffers[index];
+  }
+
+  // Queues a buffer from acquire() to be written to `filename`.
+  // The buffer belongs to the writer until acquire() hands it out again.
+  void submit(TGAImage& frame, std::string filename) {
+    // compared one by one, subtracting a pointer from outside of `buffers` would be undefined
+    size_t index = 0;
+    while (index < buffers.size() && &buffers[index] != &frame)
+      ++index;
+    {
+      std::lock_guard lock(mutex);
+      if (stopping)
+        throw std::logic_error("FrameWriter::submit() after finish()");
+      if (index == buffers.size() || !acquired[index])
+        throw std::logic_error("FrameWriter::submit() of an image acquire() didn't hand out");
+      acquired[index] = false;
+      pending.push_back(Job{ index, std::move(filename) });
+    }
+    queued.notify_one();
+  }
+
+  // Waits until every submitted frame is written and stops the writer thread. False when any write failed.
+  bool finish() {
+    {
+      std::lock_guard lock(mutex);
+      stopping = true;
+    }
+    queued.notify_one();
+    available.notify_all();
+    if (worker.joinable())
+      worker.join();
+    return failures == 0;
+  }
+
+private:
+  struct Job {
+    size_t buffer;
+    std::string filename;
+  };
+
+  void run() {
+    for (;;) {
+      Job job;
+      {
+        std::unique_lock lock(mutex);
+        queued.wait(lock, [&]() { return stopping || !pending.empty(); });
+        if (pending.empty())
+          return;
+        job = std::move(pending.front());
+        pending.pop_front();
+      }
+
+      if (!buffers[job.buffer].write_tga_file(job.filename.c_str(), rle))
+        ++failures;
+
+      {
+        std::lock_guard lock(mutex);
+        idle.push_back(job.buffer);
+      }
+      available.notify_one();
+    }
+  }
+
+  bool rle;
+  std::vector<TGAImage> buffers;
+  std::mutex mutex;
+  std::condition_variable available;
+  std::condition_variable queued;
+  std::deque<size_t> idle;
+  std::deque<Job> pending;
+  // handed out by acquire() and not submitted since
+  std::vector<bool> acquired;
+  bool stopping = false;
+  // only touched by the writer thread until it is joined
+  size_t failures = 0;
+  std::thread worker;
+};
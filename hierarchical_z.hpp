@@ -0,0 +1,155 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Conservative depth range of every 8x8 block and farthest depth of every screen tile of a z_buffer.
+// Depth grows towards the viewer (a pixel is drawn when `z_buffer[i] < z`), so a triangle whose nearest vertex
+// is not nearer than the farthest depth stored in a block can't change any pixel of it.
+// `far` may lag behind the z_buffer, it is re-read lazily and only when it could reject something: a triangle
+// nearer than everything in the block (`near`, an upper bound kept up to date on every write) can't be hidden.
+// Neither bound is ever too tight, so rejection stays exact. Tiles own their blocks, so tiles can be used from
+// different threads.
+class HierarchicalZ {
+public:
+  static constexpr int BLOCK_SIZE = 8;
+
+  HierarchicalZ(int width, int height, int tile_size)
+    : width(width)
+    , height(height)
+    , tile_size(tile_size)
+    , blocks_x((width + BLOCK_SIZE - 1) / BLOCK_SIZE)
+    , blocks_y((height + BLOCK_SIZE - 1) / BLOCK_SIZE)
+    , tiles_x((width + tile_size - 1) / tile_size)
+    , tiles_y((height + tile_size - 1) / tile_size)
+    , blocks(blocks_x * blocks_y)
+    , tile_far(tiles_x * tiles_y)
+    , tile_dirty(tiles_x * tiles_y) {
+    invalidate();
+  }
+
+  // Forgets everything known about the z_buffer, e.g. after it has been cleared or written by someone else
+  void invalidate() {
+    std::fill(blocks.begin(), blocks.end(), Block{ -std::numeric_limits<float_t>::max(), std::numeric_limits<float_t>::max(), true });
+    std::fill(tile_far.begin(), tile_far.end(), -std::numeric_limits<float_t>::max());
+    std::fill(tile_dirty.begin(), tile_dirty.end(), true);
+  }
+
+  bool occluded_tile(int tx, int ty, float_t nearest) {
+    const int tile = tx + ty * tiles_x;
+    if (nearest <= tile_far[tile])
+      return true;
+    if (!tile_dirty[tile])
+      return false;
+
+    const int blocks_per_tile = tile_size / BLOCK_SIZE;
+    const int bx_end = std::min((tx + 1) * blocks_per_tile, blocks_x);
+    const int by_end = std::min((ty + 1) * blocks_per_tile, blocks_y);
+    float_t far = std::numeric_limits<float_t>::max();
+    for (int by = ty * blocks_per_tile; by < by_end; ++by)
+      for (int bx = tx * blocks_per_tile; bx < bx_end; ++bx)
+        far = std::min(far, blocks[bx + by * blocks_x].far);
+    tile_far[tile] = far;
+    tile_dirty[tile] = false;
+    return nearest <= far;
+  }
+
+  bool occluded_block(int bx, int by, float_t nearest, const std::vector<float_t>& z_buffer) {
+    Block& block = blocks[bx + by * blocks_x];
+    if (nearest <= block.far)
+      return true;
+    if (!block.dirty || nearest > block.near)
+      return false;
+
+    const int x_begin = bx * BLOCK_SIZE;
+    const int x_end = std::min(x_begin + BLOCK_SIZE, width);
+    const int y_end = std::min((by + 1) * BLOCK_SIZE, height);
+    float_t far = std::numeric_limits<float_t>::max();
+    float_t near = -std::numeric_limits<float_t>::max();
+    if (x_end - x_begin == BLOCK_SIZE) {
+#if defined(__SSE2__)
+      __m128 far4 = _mm_set1_ps(far);
+      __m128 near4 = _mm_set1_ps(near);
+      for (int y = by * BLOCK_SIZE; y < y_end; ++y) {
+        const float_t* row = z_buffer.data() + x_begin + y * width;
+        const __m128 left = _mm_loadu_ps(row);
+        const __m128 right = _mm_loadu_ps(row + 4);
+        far4 = _mm_min_ps(far4, _mm_min_ps(left, right));
+        near4 = _mm_max_ps(near4, _mm_max_ps(left, right));
+      }
+      alignas(16) float_t fars[4];
+      alignas(16) float_t nears[4];
+      _mm_store_ps(fars, far4);
+      _mm_store_ps(nears, near4);
+      far = std::min({ fars[0], fars[1], fars[2], fars[3] });
+      near = std::max({ nears[0], nears[1], nears[2], nears[3] });
+#else
+      // one bound per column keeps the reduction vectorizable without reassociating it
+      float_t column_far[BLOCK_SIZE];
+      float_t column_near[BLOCK_SIZE];
+      std::fill(column_far, column_far + BLOCK_SIZE, far);
+      std::fill(column_near, column_near + BLOCK_SIZE, near);
+      for (int y = by * BLOCK_SIZE; y < y_end; ++y) {
+        const float_t* row = z_buffer.data() + x_begin + y * width;
+        for (int x = 0; x < BLOCK_SIZE; ++x) {
+          column_far[x] = std::min(column_far[x], row[x]);
+          column_near[x] = std::max(column_near[x], row[x]);
+        }
+      }
+      for (int x = 0; x < BLOCK_SIZE; ++x) {
+        far = std::min(far, column_far[x]);
+        near = std::max(near, column_near[x]);
+      }
+#endif
+    } else {
+      for (int y = by * BLOCK_SIZE; y < y_end; ++y) {
+        for (int x = x_begin; x < x_end; ++x) {
+          far = std::min(far, z_buffer[x + y * width]);
+          near = std::max(near, z_buffer[x + y * width]);
+        }
+      }
+    }
+
+    block.near = near;
+    block.dirty = false;
+    if (far != block.far) {
+      block.far = far;
+      tile_dirty[(bx * BLOCK_SIZE / tile_size) + (by * BLOCK_SIZE / tile_size) * tiles_x] = true;
+    }
+    return nearest <= far;
+  }
+
+  // A triangle no nearer than `nearest` may have written the block
+  void touched(int bx, int by, float_t nearest) {
+    Block& block = blocks[bx + by * blocks_x];
+    block.near = std::max(block.near, nearest);
+    block.dirty = true;
+  }
+
+private:
+  struct Block {
+    float_t far;
+    float_t near;
+    bool dirty;
+  };
+
+  int width;
+  int height;
+  int tile_size;
+  int blocks_x;
+  int blocks_y;
+  int tiles_x;
+  int tiles_y;
+  std::vector<Block> blocks;
+  std::vector<float_t> tile_far;
+  std::vector<uint8_t> tile_dirty;
+};
@@ -4,6 +4,8 @@
 #include "../tgaimage.hpp"
 #include "../model.hpp"
 #include "../rasterization.hpp"
+#include "../tile_rasterizer.hpp"
+#include "../atomic_rasterizer.hpp"
 #include "obj_loader_helper.hpp"
 
 #include <glm/glm.hpp>
@@ -102,8 +104,8 @@ inline void depth_buffer_2(TGAImage& image) {
 
   TGAImage texture{};
   texture.read_tga_file("./assets/african_head_diffuse.tga");
-  texture.flip_vertically();
 
+  TileRasterizer rasterizer(width, height);
 
   load_model_and_for_each_face("./assets/african_head.obj", [&](auto face_vertices, auto face_normals, auto face_texcoords) -> void {
     // Render it
@@ -124,17 +126,54 @@ inline void depth_buffer_2(TGAImage& image) {
 
     std::transform(world_coords.begin(), world_coords.end(), screen_coords.begin(), [&](auto& x) { return world_to_screen(x, width, height); });
 
-    raster_triangle_with_depth_buffer(screen_coords, face_texcoords, z_buffer, image, texture, light_intensity);
+    rasterizer.submit(screen_coords, face_texcoords, light_intensity);
   });
 
+  rasterizer.flush(z_buffer, image, texture);
+
    { // dump z-buffer (debugging purposes only)
-        TGAImage zbimage(width, height, TGAImage::GRAYSCALE);
+        // i want to have the origin at the left bottom corner of the image
+        TGAImage zbimage(width, height, TGAImage::GRAYSCALE, TGAImage::BOTTOM_LEFT);
         for (int i=0; i<width; i++) {
             for (int j=0; j<height; j++) {
                 zbimage.set(i, j, TGAColor(int((0.5 + z_buffer[i+j*width]) / 2 * 0xFF), 1));
             }
         }
-        zbimage.flip_vertically(); // i want to have the origin at the left bottom corner of the image
         zbimage.write_tga_file("zbuffer.tga");
     }
-}
\ No newline at end of file
+}
+
+// depth_buffer_2 with triangle ranges rasterized in parallel straight into a shared atomic framebuffer
+inline void depth_buffer_3(TGAImage& image) {
+  const size_t width = image.get_width();
+  const size_t height = image.get_height();
+
+  constexpr glm::vec3 light_dir{ 0.3, 0, -1 };
+  constexpr float_t ambient_light_contribution = 0.4;
+
+  std::vector<float_t> z_buffer(width * height);
+
+  TGAImage texture{};
+  texture.read_tga_file("./assets/african_head_diffuse.tga");
+
+  AtomicFramebuffer framebuffer(width, height);
+  AtomicRasterizer rasterizer(width, height);
+
+  load_model_and_for_each_face("./assets/african_head.obj", [&](auto face_vertices, auto face_normals, auto face_texcoords) -> void {
+    std::array<glm::vec3, 3> screen_coords;
+
+    auto& [a, b, c] = face_vertices;
+    auto face_normal = glm::normalize(glm::cross(c - a, b - a));
+    const float_t light_intensity = glm::clamp(glm::dot(face_normal, light_dir) + ambient_light_contribution, 0.f, 1.f);
+
+    if (light_intensity <= 0)
+      return;
+
+    std::transform(face_vertices.begin(), face_vertices.end(), screen_coords.begin(), [&](auto& x) { return world_to_screen(x, width, height); });
+
+    rasterizer.submit(screen_coords, face_texcoords, light_intensity);
+  });
+
+  rasterizer.flush(framebuffer, texture);
+  framebuffer.resolve(image, z_buffer);
+}
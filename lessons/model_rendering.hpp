@@ -4,6 +4,7 @@
 #include "../tga_color.hpp"
 #include "../tgaimage.hpp"
 #include "../rasterization.hpp"
+#include "../shaders.hpp"
 #include "glm/geometric.hpp"
 
 #include <random>
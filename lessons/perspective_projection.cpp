@@ -1,6 +1,12 @@
 #include "perspective_projection.hpp"
 #include "../obj_loader_helper.hpp"
+#include "../clipping.hpp"
+#include "../mesh_optimizer.hpp"
+#include "../meshlets.hpp"
 #include "../rasterization.hpp"
+#include "../texture.hpp"
+#include "../tile_rasterizer.hpp"
+#include "../vertex_processing.hpp"
 #include "glm/trigonometric.hpp"
 #include "tga_color.hpp"
 
@@ -76,7 +82,7 @@ void perspective_projection_study_1(TGAImage& image) {
 void perspective_projection_study_2(TGAImage& image) {
   // clang-format off
   const glm::vec3 scale{ 1.0f, 1.0f, 1.0f };
-  const glm::vec3 translation{ 0.0f, 0.0f, 1.0f };
+  const glm::vec3 translation{ 0.0f, 0.0f, -2.0f };
   const glm::vec3 rotation{ glm::radians(0.0f), glm::radians(0.0f), glm::radians(0.0f)};
 
   glm::mat4 model_scale_matrix{MAT4x4_ROW_MAJOR_INIT_LIST(
@@ -106,9 +112,11 @@ void perspective_projection_study_2(TGAImage& image) {
   constexpr float_t z_near = 0.5f;
   constexpr float_t z_far = 10000.0f;
   std::vector<float_t> z_buffer(width * height, -std::numeric_limits<float_t>::max());
-  TGAImage texture{};
-  texture.read_tga_file("./assets/african_head_diffuse.tga");
-  texture.flip_vertically();
+  TGAImage diffuse{};
+  diffuse.read_tga_file("./assets/african_head_diffuse.tga");
+  // the head covers a small part of the screen, most triangles sample a mip level well below the full 1024x1024
+  const Texture2D texture(diffuse);
+  TileRasterizer rasterizer(width, height, TileRasterizer::FIXED_POINT);
   
   constexpr float_t fov = 180.0f;
   const float_t $fv = 1.0f / glm::tan(fov / 2.0f);
@@ -124,41 +132,91 @@ void perspective_projection_study_2(TGAImage& image) {
   )};
   // clang-format on
 
-  load_model_and_for_each_face("assets/african_head.obj", [&](auto face_vertices, auto face_normals, auto face_texcoords) -> void {
-    std::array<glm::vec3, 3> screen_coords;
-
-    std::transform(face_vertices.begin(), face_vertices.end(), screen_coords.begin(), [&](auto& p) {
-      auto perspective_pos = perspective_projection_matrix * model_transformation_matrix * glm::vec4(p, 1.0f);
-      if (perspective_pos.z != 0.0f) {
-        perspective_pos.x /= perspective_pos.z;
-        perspective_pos.y /= perspective_pos.z;
-        perspective_pos.z /= perspective_pos.z;
+  const glm::mat4 model_view_projection_matrix = perspective_projection_matrix * model_transformation_matrix;
+
+  // clusters of ~100 triangles are culled as a whole before any of their vertices is transformed
+  IndexedMesh mesh = load_indexed_model("assets/african_head.obj");
+  optimize_vertex_cache(mesh);
+  optimize_vertex_fetch(mesh);
+  const MeshletMesh meshlets = build_meshlets(mesh);
+  const Viewport viewport = make_viewport(image.get_width(), image.get_height());
+  const std::array<glm::vec4, 6> frustum = frustum_planes(model_view_projection_matrix);
+  const glm::vec3 eye = glm::inverse(model_transformation_matrix) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  VertexStream vertices;
+
+  auto draw_meshlet = [&](const Meshlet& meshlet) {
+    transform_vertices(meshlets.positions, meshlet.vertex_offset, meshlet.vertex_count, model_view_projection_matrix, viewport, vertices);
+
+    for (size_t f = 0; f < meshlet.triangle_count; ++f) {
+      std::array<size_t, 3> face;
+      for (size_t i = 0; i < 3; ++i)
+        face[i] = meshlet.vertex_offset + meshlets.triangles[3 * (meshlet.triangle_offset + f) + i];
+      const glm::vec3 a = mesh.position(meshlets.vertices[face[0]]);
+      const glm::vec3 b = mesh.position(meshlets.vertices[face[1]]);
+      const glm::vec3 c = mesh.position(meshlets.vertices[face[2]]);
+      auto wcu = c - a;
+      auto wcv = b - a;
+      auto face_normal = glm::normalize(glm::cross(wcu, wcv));
+      const float_t nl_dot = glm::dot(face_normal, light_dir);
+      const float_t light_intensity = glm::clamp((nl_dot + 0.1f / 2.0f) + ambient_light_contribution, 0.0f, 1.0f);
+
+      if (light_intensity <= std::numeric_limits<float_t>::epsilon())
+        continue;
+
+      std::array<ClipVertex, 3> clip_coords;
+      for (size_t i = 0; i < 3; ++i)
+        clip_coords[i] = ClipVertex{ vertices.clip(face[i]), mesh.texcoord(meshlets.vertices[face[i]]) };
+
+      // nothing reaching behind the near plane gets divided, so screen coordinates stay bounded
+      const ClipPolygon polygon = clip_triangle(clip_coords);
+
+      // depth is kept as 1/w, see clip_to_screen. Only vertices made by the clipper still need their divide.
+      std::array<glm::vec3, MAX_CLIP_POLYGON> screen_coords;
+      for (size_t i = 0; i < polygon.size; ++i) {
+        if (polygon.clipped)
+          screen_coords[i] = clip_to_screen(polygon.vertices[i].position, viewport);
+        else
+          screen_coords[i] = vertices.screen(face[i]);
       }
-      return world_to_screen(
-          perspective_pos,
-          image.get_width(),
-          image.get_height()
-      );
-    });
-
-    auto& [a, b, c] = face_vertices;
-    auto wcu = c - a;
-    auto wcv = b - a;
-    auto face_normal = glm::normalize(glm::cross(wcu, wcv));
-    std::cout << wcu.x << " - " << wcu.y << std::endl;
-    const float_t nl_dot = glm::dot(face_normal, light_dir);
-    const float_t light_intensity = glm::clamp((nl_dot + 0.1f / 2.0f) + ambient_light_contribution, 0.0f, 1.0f);
-
-    if (light_intensity <= std::numeric_limits<float_t>::epsilon())
-      return;
-
-    raster_triangle_with_depth_buffer(screen_coords, face_texcoords, z_buffer, image, texture, light_intensity);
 
-    glm::vec2 x_axis{ 1, 0 };
-    glm::vec2 y_axis{ 0, 1 };
-    glm::vec2 screen_origin{ image.get_width() / 2, image.get_height() / 2 };
-
-    image.line(screen_origin, screen_origin + x_axis * screen_origin / 2.0f, RED);
-    image.line(screen_origin, screen_origin + y_axis * screen_origin / 2.0f, GREEN);
+      for (size_t i = 2; i < polygon.size; ++i) {
+        rasterizer.submit(
+          { screen_coords[0], screen_coords[i - 1], screen_coords[i] },
+          { polygon.vertices[0].texcoord, polygon.vertices[i - 1].texcoord, polygon.vertices[i].texcoord },
+          light_intensity
+        );
+      }
+    }
+  };
+
+  std::vector<const Meshlet*> visible;
+  for (const Meshlet& meshlet : meshlets.meshlets) {
+    if (!meshlet_outside_frustum(meshlet, frustum) && !meshlet_backfacing(meshlet, eye))
+      visible.push_back(&meshlet);
+  }
+
+  // the nearer half is drawn first and becomes the occluder the farther half is tested against
+  std::sort(visible.begin(), visible.end(), [&](const Meshlet* l, const Meshlet* r) {
+    return (model_view_projection_matrix * glm::vec4(l->center, 1.0f)).w < (model_view_projection_matrix * glm::vec4(r->center, 1.0f)).w;
   });
+  const size_t occluders = visible.size() / 2;
+  for (size_t i = 0; i < occluders; ++i)
+    draw_meshlet(*visible[i]);
+  rasterizer.flush(z_buffer, image, texture);
+
+  for (size_t i = occluders; i < visible.size(); ++i) {
+    glm::vec2 min, max;
+    float_t nearest;
+    if (meshlet_screen_bounds(*visible[i], model_view_projection_matrix, viewport, min, max, nearest) && rasterizer.occluded(min, max, nearest, z_buffer))
+      continue;
+    draw_meshlet(*visible[i]);
+  }
+  rasterizer.flush(z_buffer, image, texture);
+
+  glm::vec2 x_axis{ 1, 0 };
+  glm::vec2 y_axis{ 0, 1 };
+  glm::vec2 screen_origin{ image.get_width() / 2, image.get_height() / 2 };
+
+  image.line(screen_origin, screen_origin + x_axis * screen_origin / 2.0f, RED);
+  image.line(screen_origin, screen_origin + y_axis * screen_origin / 2.0f, GREEN);
 }
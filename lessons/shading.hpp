@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../obj_loader_helper.hpp"
+#include "../pipeline.hpp"
+#include "../shaders.hpp"
+#include "../tga_color.hpp"
+#include "../tgaimage.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <limits>
+#include <vector>
+
+inline std::array<MeshVertex, 3> mesh_face(const std::array<glm::vec3, 3>& vertices, const std::array<glm::vec3, 3>& normals, const std::array<glm::vec2, 3>& texcoords) {
+  return { MeshVertex{ vertices[0], normals[0], texcoords[0] }, MeshVertex{ vertices[1], normals[1], texcoords[1] }, MeshVertex{ vertices[2], normals[2], texcoords[2] } };
+}
+
+inline float_t face_light_intensity(const std::array<glm::vec3, 3>& vertices, glm::vec3 light_dir, float_t ambient) {
+  auto& [a, b, c] = vertices;
+  auto face_normal = glm::normalize(glm::cross(c - a, b - a));
+  return glm::clamp(glm::dot(face_normal, light_dir) + ambient, 0.f, 1.f);
+}
+
+inline void flat_shading(TGAImage& image) {
+  const size_t width = image.get_width();
+  const size_t height = image.get_height();
+  constexpr glm::vec3 light_dir{ 0.3, 0, -1 };
+  std::vector<float_t> z_buffer(width * height, -std::numeric_limits<float_t>::max());
+
+  Pipeline<ScreenVertexShader, FlatFragmentShader> pipeline({ width, height });
+
+  load_model_and_for_each_face("./assets/african_head.obj", [&](auto face_vertices, auto face_normals, auto face_texcoords) -> void {
+    const float_t light_intensity = face_light_intensity(face_vertices, light_dir, 0.0f);
+    if (light_intensity <= 0)
+      return;
+
+    pipeline.fragment_shader().color = TGAColor(WHITE) * light_intensity;
+    pipeline.fragment_shader().color.a = 255;
+    pipeline.draw(mesh_face(face_vertices, face_normals, face_texcoords), z_buffer, image);
+  });
+}
+
+inline void gouraud_shading(TGAImage& image) {
+  const size_t width = image.get_width();
+  const size_t height = image.get_height();
+  constexpr glm::vec3 light_dir{ 0.3, 0, -1 };
+  std::vector<float_t> z_buffer(width * height, -std::numeric_limits<float_t>::max());
+
+  // the vertex normals of african_head point outwards, the light comes towards -z
+  Pipeline<GouraudVertexShader, GouraudFragmentShader> pipeline({ width, height, -light_dir, 0.1f }, { WHITE });
+
+  load_model_and_for_each_face("./assets/african_head.obj", [&](auto face_vertices, auto face_normals, auto face_texcoords) -> void {
+    pipeline.draw(mesh_face(face_vertices, face_normals, face_texcoords), z_buffer, image);
+  });
+}
+
+inline void textured_shading(TGAImage& image) {
+  const size_t width = image.get_width();
+  const size_t height = image.get_height();
+  constexpr glm::vec3 light_dir{ 0.3, 0, -1 };
+  constexpr float_t ambient_light_contribution = 0.4;
+  std::vector<float_t> z_buffer(width * height, -std::numeric_limits<float_t>::max());
+
+  TGAImage texture{};
+  texture.read_tga_file("./assets/african_head_diffuse.tga");
+
+  Pipeline<TexturedVertexShader, TexturedFragmentShader<TGAImage>> pipeline({ width, height }, { &texture, 0 });
+
+  load_model_and_for_each_face("./assets/african_head.obj", [&](auto face_vertices, auto face_normals, auto face_texcoords) -> void {
+    const float_t light_intensity = face_light_intensity(face_vertices, light_dir, ambient_light_contribution);
+    if (light_intensity <= 0)
+      return;
+
+    pipeline.fragment_shader().light_intensity = light_intensity;
+    pipeline.draw(mesh_face(face_vertices, face_normals, face_texcoords), z_buffer, image);
+  });
+}
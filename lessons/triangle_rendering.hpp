@@ -3,6 +3,7 @@
 #include "../tga_color.hpp"
 #include "../tgaimage.hpp"
 #include "../rasterization.hpp"
+#include "../shaders.hpp"
 
 inline void triangle_rendering(TGAImage& image) {
   const size_t width = image.get_width();
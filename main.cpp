@@ -1,3 +1,5 @@
+#include "frame_stream.hpp"
+#include "frame_writer.hpp"
 #include "model.hpp"
 #include "tgaimage.hpp"
 
@@ -8,6 +10,7 @@
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <limits>
 #include <sched.h>
@@ -20,20 +23,34 @@
 #include "lessons/triangle_rendering.hpp"
 #include "lessons/depth_buffer.hpp"
 #include "lessons/perspective_projection.hpp"
+#include "lessons/shading.hpp"
 
-int main(int, char**) {
+int main(int argc, char** argv) {
 
-  TGAImage image(800, 800, TGAImage::RGB);
+  // writes finished frames on its own thread, a loop over frames keeps rendering meanwhile
+  FrameWriter writer(800, 800, TGAImage::RGB);
+  TGAImage& image = writer.acquire();
   
   // triangle_rendering(image);
   // model_rendering(image);
   // depth_buffer_1(image);
   // depth_buffer_2(image);
+  // depth_buffer_3(image);
   // perspective_projection_study_1(image);
   perspective_projection_study_2(image);
+  // flat_shading(image);
+  // gouraud_shading(image);
+  // textured_shading(image);
 
-  image.flip_vertically(); // i want to have the origin at the left bottom
-  image.write_tga_file("result.tga");
+  // `main --ppm` or `main --y4m` pipes the frame into an encoder through stdout instead of writing result.tga
+  if (argc > 1 && (!strcmp(argv[1], "--ppm") || !strcmp(argv[1], "--y4m"))) {
+    FrameStream stream(!strcmp(argv[1], "--ppm") ? FrameStream::PPM : FrameStream::Y4M);
+    stream.open(STDOUT_FILENO);
+    const bool written = stream.write(image);
+    return writer.finish() && written ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
 
-  return EXIT_SUCCESS;
+  writer.submit(image, "result.tga"); // the origin is at the left bottom, as rendered
+
+  return writer.finish() ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <utility>
+
+// Read-only private mapping of a whole file. The pages come straight from the page cache, so nothing is copied and
+// every process mapping the same file shares them.
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept
+    : bytes(std::exchange(other.bytes, nullptr))
+    , length(std::exchange(other.length, 0)) {
+  }
+
+  MappedFile& operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+      close();
+      bytes = std::exchange(other.bytes, nullptr);
+      length = std::exchange(other.length, 0);
+    }
+    return *this;
+  }
+
+  ~MappedFile() { close(); }
+
+  bool open(const char* filename) {
+    close();
+    const int fd = ::open(filename, O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+    void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive on its own
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+      return false;
+    bytes = static_cast<const unsigned char*>(mapping);
+    length = st.st_size;
+    return true;
+  }
+
+  void close() {
+    if (bytes)
+      munmap(const_cast<unsigned char*>(bytes), length);
+    bytes = nullptr;
+    length = 0;
+  }
+
+  // Hint that the whole file is about to be read front to back
+  void will_need() const {
+    if (bytes)
+      madvise(const_cast<unsigned char*>(bytes), length, MADV_WILLNEED);
+  }
+
+  const unsigned char* data() const { return bytes; }
+  size_t size() const { return length; }
+
+private:
+  const unsigned char* bytes = nullptr;
+  size_t length = 0;
+};
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "obj_loader_helper.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Post-transform cache behaviour of an index buffer, simulated with a FIFO cache of `cache_size` positions
+struct VertexCacheStatistics {
+  size_t triangles = 0;
+  size_t vertices = 0;
+  size_t transforms = 0;
+
+  // average cache miss ratio, transforms per triangle: 3 without any reuse, 0.5 at best for large regular meshes
+  float_t acmr() const { return triangles ? float_t(transforms) / triangles : 0; }
+  // average transform to vertex ratio, 1 means every referenced vertex is transformed exactly once
+  float_t atvr() const { return vertices ? float_t(transforms) / vertices : 0; }
+};
+
+inline VertexCacheStatistics analyze_vertex_cache(const IndexedMesh& mesh, size_t cache_size = 16) {
+  VertexCacheStatistics statistics{};
+  statistics.triangles = mesh.triangle_count();
+
+  // a vertex is in the FIFO while fewer than cache_size misses happened since it was loaded
+  std::vector<size_t> loaded_at(mesh.vertex_count(), 0);
+  std::vector<bool> referenced(mesh.vertex_count(), false);
+  for (const tinyobj::index_t& idx : mesh.indices) {
+    const size_t v = idx.vertex_index;
+    if (!referenced[v]) {
+      referenced[v] = true;
+      ++statistics.vertices;
+    }
+    if (loaded_at[v] == 0 || statistics.transforms - loaded_at[v] >= cache_size)
+      loaded_at[v] = ++statistics.transforms;
+  }
+  return statistics;
+}
+
+// Reorders the triangles for post-transform cache reuse with Tipsify (Sander, Nehab, Barczak 2007): fans around
+// one vertex at a time and moves on to the neighbour that is still in the cache and has the fewest triangles left,
+// falling back to recently used vertices at dead ends. Linear in the number of triangles, winding is kept.
+// It also keeps consecutive triangles close to each other on screen, which the tile binner likes too.
+inline void optimize_vertex_cache(IndexedMesh& mesh, size_t cache_size = 16) {
+  const size_t vertex_count = mesh.vertex_count();
+  const size_t triangle_count = mesh.triangle_count();
+
+  // vertex to triangle adjacency in compressed rows
+  std::vector<uint32_t> live(vertex_count, 0);
+  for (const tinyobj::index_t& idx : mesh.indices)
+    ++live[idx.vertex_index];
+  std::vector<uint32_t> offsets(vertex_count + 1, 0);
+  for (size_t v = 0; v < vertex_count; ++v)
+    offsets[v + 1] = offsets[v] + live[v];
+  std::vector<uint32_t> adjacency(mesh.indices.size());
+  {
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < mesh.indices.size(); ++i)
+      adjacency[fill[mesh.indices[i].vertex_index]++] = i / 3;
+  }
+
+  std::vector<size_t> cache_time(vertex_count, 0);
+  size_t time = cache_size + 1;
+  std::vector<bool> emitted(triangle_count, false);
+  std::vector<uint32_t> dead_end;
+  std::vector<uint32_t> candidates;
+  size_t cursor = 0;
+
+  std::vector<tinyobj::index_t> indices;
+  indices.reserve(mesh.indices.size());
+
+  for (int64_t fan = vertex_count ? 0 : -1; fan >= 0;) {
+    candidates.clear();
+    for (uint32_t a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+      const uint32_t t = adjacency[a];
+      if (emitted[t])
+        continue;
+      emitted[t] = true;
+      for (size_t k = 0; k < 3; ++k) {
+        const tinyobj::index_t idx = mesh.indices[3 * t + k];
+        const uint32_t v = idx.vertex_index;
+        indices.push_back(idx);
+        dead_end.push_back(v);
+        candidates.push_back(v);
+        --live[v];
+        if (time - cache_time[v] > cache_size)
+          cache_time[v] = time++;
+      }
+    }
+
+    // best candidate: still has triangles and stays in the cache while they are emitted, oldest entry first
+    fan = -1;
+    size_t best_priority = 0;
+    for (uint32_t v : candidates) {
+      if (live[v] == 0)
+        continue;
+      size_t priority = 0;
+      if (time - cache_time[v] + 2 * live[v] <= cache_size)
+        priority = time - cache_time[v];
+      if (fan < 0 || priority > best_priority) {
+        fan = v;
+        best_priority = priority;
+      }
+    }
+    if (fan >= 0)
+      continue;
+
+    while (!dead_end.empty() && fan < 0) {
+      const uint32_t v = dead_end.back();
+      dead_end.pop_back();
+      if (live[v] > 0)
+        fan = v;
+    }
+    for (; fan < 0 && cursor < vertex_count; ++cursor) {
+      if (live[cursor] > 0)
+        fan = cursor;
+    }
+  }
+
+  mesh.indices = std::move(indices);
+}
+
+// Renumbers `stride` floats wide elements in order of first use, elements nobody references go to the end
+inline void remap_attribute(std::vector<tinyobj::real_t>& data, size_t stride, const std::vector<int>& remap) {
+  if (data.empty())
+    return;
+  std::vector<tinyobj::real_t> remapped(data.size());
+  for (size_t i = 0; i < remap.size(); ++i)
+    std::copy_n(data.begin() + i * stride, stride, remapped.begin() + remap[i] * stride);
+  data = std::move(remapped);
+}
+
+inline std::vector<int> first_use_order(IndexedMesh& mesh, size_t count, int tinyobj::index_t::*member) {
+  std::vector<int> remap(count, -1);
+  int next = 0;
+  for (tinyobj::index_t& idx : mesh.indices) {
+    int& index = idx.*member;
+    if (index < 0)
+      continue;
+    if (remap[index] < 0)
+      remap[index] = next++;
+    index = remap[index];
+  }
+  for (int& r : remap) {
+    if (r < 0)
+      r = next++;
+  }
+  return remap;
+}
+
+// Renumbers positions, normals and texture coordinates in the order the index buffer first touches them, so the
+// vertex stage and the attribute fetches of consecutive triangles read memory mostly front to back.
+// Run it after optimize_vertex_cache, the triangle order is what defines "first".
+inline void optimize_vertex_fetch(IndexedMesh& mesh) {
+  tinyobj::attrib_t& attrib = mesh.attrib;
+
+  const std::vector<int> positions = first_use_order(mesh, attrib.vertices.size() / 3, &tinyobj::index_t::vertex_index);
+  remap_attribute(attrib.vertices, 3, positions);
+  remap_attribute(attrib.vertex_weights, 1, positions);
+  remap_attribute(attrib.colors, 3, positions);
+  for (tinyobj::skin_weight_t& weight : attrib.skin_weights)
+    weight.vertex_id = positions[weight.vertex_id];
+
+  const std::vector<int> normals = first_use_order(mesh, attrib.normals.size() / 3, &tinyobj::index_t::normal_index);
+  remap_attribute(attrib.normals, 3, normals);
+
+  const std::vector<int> texcoords = first_use_order(mesh, attrib.texcoords.size() / 2, &tinyobj::index_t::texcoord_index);
+  remap_attribute(attrib.texcoords, 2, texcoords);
+  remap_attribute(attrib.texcoord_ws, 1, texcoords);
+}
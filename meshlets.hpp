@@ -0,0 +1,204 @@
+#pragma once
+
+#include "obj_loader_helper.hpp"
+#include "vertex_processing.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+constexpr size_t MESHLET_MAX_VERTICES = 64;
+constexpr size_t MESHLET_MAX_TRIANGLES = 124;
+
+// A small cluster of triangles with everything needed to reject it before any of its vertices is transformed.
+// Vertices are local to the meshlet (shared ones are duplicated across meshlet borders), so the vertex stage of a
+// meshlet is one contiguous range of MeshletMesh::positions.
+struct Meshlet {
+  uint32_t vertex_offset;
+  uint32_t vertex_count;
+  uint32_t triangle_offset;
+  uint32_t triangle_count;
+
+  // bounding sphere, model space
+  glm::vec3 center;
+  float_t radius;
+  // every triangle normal (counter-clockwise winding) is within acos(sqrt(1 - cone_cutoff^2)) of cone_axis,
+  // cone_cutoff is 1 when the normals are spread too wide for the cone to ever reject anything
+  glm::vec3 cone_axis;
+  float_t cone_cutoff;
+};
+
+struct MeshletMesh {
+  std::vector<Meshlet> meshlets;
+  // meshlet local vertex -> attribute indices of the source mesh
+  std::vector<tinyobj::index_t> vertices;
+  // positions of `vertices`, for transform_vertices
+  PositionStream positions;
+  // three meshlet local vertex indices per triangle
+  std::vector<uint8_t> triangles;
+};
+
+inline void compute_meshlet_bounds(const MeshletMesh& result, Meshlet& meshlet) {
+  auto position = [&](uint32_t local) {
+    const size_t i = meshlet.vertex_offset + local;
+    return glm::vec3(result.positions.x[i], result.positions.y[i], result.positions.z[i]);
+  };
+
+  glm::vec3 min = position(0);
+  glm::vec3 max = min;
+  for (uint32_t v = 1; v < meshlet.vertex_count; ++v) {
+    min = glm::min(min, position(v));
+    max = glm::max(max, position(v));
+  }
+  meshlet.center = (min + max) * 0.5f;
+  meshlet.radius = 0;
+  for (uint32_t v = 0; v < meshlet.vertex_count; ++v)
+    meshlet.radius = std::max(meshlet.radius, glm::length(position(v) - meshlet.center));
+
+  std::array<glm::vec3, MESHLET_MAX_TRIANGLES> normals;
+  size_t normal_count = 0;
+  glm::vec3 axis{ 0 };
+  for (uint32_t t = 0; t < meshlet.triangle_count; ++t) {
+    const uint8_t* triangle = &result.triangles[3 * (meshlet.triangle_offset + t)];
+    const glm::vec3 a = position(triangle[0]);
+    const glm::vec3 n = glm::cross(position(triangle[1]) - a, position(triangle[2]) - a);
+    const float_t length = glm::length(n);
+    // degenerate triangles never face anywhere
+    if (length > 0) {
+      normals[normal_count++] = n / length;
+      axis += n / length;
+    }
+  }
+
+  meshlet.cone_axis = glm::vec3(0, 0, 1);
+  meshlet.cone_cutoff = 1;
+  const float_t axis_length = glm::length(axis);
+  if (axis_length == 0)
+    return;
+  axis /= axis_length;
+
+  float_t min_dot = 1;
+  for (size_t i = 0; i < normal_count; ++i)
+    min_dot = std::min(min_dot, glm::dot(axis, normals[i]));
+  // a cone wider than ~85 degrees rejects too rarely to be worth the test
+  if (min_dot <= 0.1f)
+    return;
+  meshlet.cone_axis = axis;
+  meshlet.cone_cutoff = std::sqrt(1 - min_dot * min_dot);
+}
+
+// Splits the mesh into meshlets greedily in index order, run optimize_vertex_cache first so consecutive triangles
+// share vertices and the clusters come out compact.
+inline MeshletMesh build_meshlets(const IndexedMesh& mesh) {
+  MeshletMesh result{};
+  Meshlet meshlet{};
+
+  auto finish = [&]() {
+    if (meshlet.triangle_count == 0)
+      return;
+    compute_meshlet_bounds(result, meshlet);
+    result.meshlets.push_back(meshlet);
+    meshlet = Meshlet{};
+    meshlet.vertex_offset = result.vertices.size();
+    meshlet.triangle_offset = result.triangles.size() / 3;
+  };
+
+  // local index of an attribute triple, MESHLET_MAX_VERTICES when it isn't in the current meshlet yet
+  auto find = [&](tinyobj::index_t idx) -> uint32_t {
+    for (uint32_t v = 0; v < meshlet.vertex_count; ++v) {
+      const tinyobj::index_t& other = result.vertices[meshlet.vertex_offset + v];
+      if (other.vertex_index == idx.vertex_index && other.normal_index == idx.normal_index && other.texcoord_index == idx.texcoord_index)
+        return v;
+    }
+    return MESHLET_MAX_VERTICES;
+  };
+
+  for (size_t t = 0; t < mesh.triangle_count(); ++t) {
+    const tinyobj::index_t* face = &mesh.indices[3 * t];
+    std::array<uint32_t, 3> local;
+    size_t added = 0;
+    for (size_t k = 0; k < 3; ++k) {
+      local[k] = find(face[k]);
+      added += local[k] == MESHLET_MAX_VERTICES;
+    }
+    if (meshlet.vertex_count + added > MESHLET_MAX_VERTICES || meshlet.triangle_count == MESHLET_MAX_TRIANGLES) {
+      finish();
+      local = { MESHLET_MAX_VERTICES, MESHLET_MAX_VERTICES, MESHLET_MAX_VERTICES };
+    }
+
+    for (size_t k = 0; k < 3; ++k) {
+      // a face may use the same vertex twice, the first of them was only added now
+      if (local[k] == MESHLET_MAX_VERTICES)
+        local[k] = find(face[k]);
+      if (local[k] == MESHLET_MAX_VERTICES) {
+        local[k] = meshlet.vertex_count++;
+        const glm::vec3 p = mesh.position(face[k]);
+        result.vertices.push_back(face[k]);
+        result.positions.x.push_back(p.x);
+        result.positions.y.push_back(p.y);
+        result.positions.z.push_back(p.z);
+      }
+      result.triangles.push_back(local[k]);
+    }
+    ++meshlet.triangle_count;
+  }
+  finish();
+  return result;
+}
+
+// Planes `dot(plane, (p, 1)) >= 0` of the clip volume of `matrix` (D3D style: 0 <= z <= w), normalized so the
+// distance to a point comes out in the units of the space `matrix` transforms from
+inline std::array<glm::vec4, 6> frustum_planes(const glm::mat4& matrix) {
+  const glm::mat4 rows = glm::transpose(matrix);
+  std::array<glm::vec4, 6> planes{
+    rows[3] + rows[0],
+    rows[3] - rows[0],
+    rows[3] + rows[1],
+    rows[3] - rows[1],
+    rows[2],
+    rows[3] - rows[2],
+  };
+  for (glm::vec4& plane : planes)
+    plane /= glm::length(glm::vec3(plane));
+  return planes;
+}
+
+inline bool meshlet_outside_frustum(const Meshlet& meshlet, const std::array<glm::vec4, 6>& planes) {
+  for (const glm::vec4& plane : planes) {
+    if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w < -meshlet.radius)
+      return true;
+  }
+  return false;
+}
+
+// True when every triangle of the meshlet faces away from `eye` (model space), from any point of its bounding sphere
+inline bool meshlet_backfacing(const Meshlet& meshlet, glm::vec3 eye) {
+  const glm::vec3 view = meshlet.center - eye;
+  return glm::dot(view, meshlet.cone_axis) >= meshlet.cone_cutoff * glm::length(view) + meshlet.radius;
+}
+
+// Screen space bounding box and nearest depth (1/w, see clip_to_screen) of the meshlet's bounding sphere.
+// Returns false when the sphere reaches behind the eye and no finite bounds exist.
+inline bool meshlet_screen_bounds(const Meshlet& meshlet, const glm::mat4& mvp, const Viewport& viewport, glm::vec2& min, glm::vec2& max, float_t& nearest) {
+  min = glm::vec2(std::numeric_limits<float_t>::max());
+  max = glm::vec2(-std::numeric_limits<float_t>::max());
+  nearest = -std::numeric_limits<float_t>::max();
+  // the corners of the sphere's bounding cube project to a box around the sphere's projection
+  for (int corner = 0; corner < 8; ++corner) {
+    const glm::vec3 offset{ corner & 1 ? meshlet.radius : -meshlet.radius, corner & 2 ? meshlet.radius : -meshlet.radius, corner & 4 ? meshlet.radius : -meshlet.radius };
+    const glm::vec4 clip = mvp * glm::vec4(meshlet.center + offset, 1.0f);
+    if (clip.w <= 0)
+      return false;
+    const glm::vec3 screen = clip_to_screen(clip, viewport);
+    min = glm::min(min, glm::vec2(screen));
+    max = glm::max(max, glm::vec2(screen));
+    nearest = std::max(nearest, screen.z);
+  }
+  return true;
+}
@@ -5,12 +5,13 @@
 
 #include <functional>
 #include <iostream>
+#include <string>
+#include <vector>
 
 using for_each_fn = std::function<void(std::array<glm::vec3, 3> face_vertices, std::array<glm::vec3, 3> face_normals, std::array<glm::vec2, 3> face_texcoords)>;
 
-inline void load_model_and_for_each_face(std::string inputfile, for_each_fn fn) {
+inline void parse_model(tinyobj::ObjReader& reader, const std::string& inputfile) {
   tinyobj::ObjReaderConfig reader_config{};
-  tinyobj::ObjReader reader{};
 
   if (!reader.ParseFromFile(inputfile, reader_config)) {
     if (!reader.Error().empty()) {
@@ -20,8 +21,13 @@ inline void load_model_and_for_each_face(std::string inputfile, for_each_fn fn)
   }
 
   if (!reader.Warning().empty()) {
-    std::cout << "TinyObjReader: " << reader.Warning();
+    std::cerr << "TinyObjReader: " << reader.Warning();
   }
+}
+
+inline void load_model_and_for_each_face(std::string inputfile, for_each_fn fn) {
+  tinyobj::ObjReader reader{};
+  parse_model(reader, inputfile);
 
   auto& attrib = reader.GetAttrib();
   auto& shapes = reader.GetShapes();
@@ -80,4 +86,44 @@ inline void load_model_and_for_each_face(std::string inputfile, for_each_fn fn)
       fn(face_vertices, face_normals, face_texcoords);
     }
   }
-}
\ No newline at end of file
+}
+
+// Shared vertex attributes plus three indices per triangle, the reader triangulates polygons on load.
+// Lets the vertex stage run once per unique position instead of once per face corner.
+struct IndexedMesh {
+  tinyobj::attrib_t attrib;
+  std::vector<tinyobj::index_t> indices;
+
+  size_t vertex_count() const { return attrib.vertices.size() / 3; }
+  size_t triangle_count() const { return indices.size() / 3; }
+
+  glm::vec3 position(tinyobj::index_t idx) const {
+    const size_t i = 3 * size_t(idx.vertex_index);
+    return glm::vec3{ attrib.vertices[i + 0], attrib.vertices[i + 1], attrib.vertices[i + 2] };
+  }
+
+  glm::vec3 normal(tinyobj::index_t idx) const {
+    if (idx.normal_index < 0)
+      return glm::vec3{};
+    const size_t i = 3 * size_t(idx.normal_index);
+    return glm::vec3{ attrib.normals[i + 0], attrib.normals[i + 1], attrib.normals[i + 2] };
+  }
+
+  glm::vec2 texcoord(tinyobj::index_t idx) const {
+    if (idx.texcoord_index < 0)
+      return glm::vec2{};
+    const size_t i = 2 * size_t(idx.texcoord_index);
+    return glm::vec2{ attrib.texcoords[i + 0], attrib.texcoords[i + 1] };
+  }
+};
+
+inline IndexedMesh load_indexed_model(std::string inputfile) {
+  tinyobj::ObjReader reader{};
+  parse_model(reader, inputfile);
+
+  IndexedMesh mesh{};
+  mesh.attrib = reader.GetAttrib();
+  for (auto& shape : reader.GetShapes())
+    mesh.indices.insert(mesh.indices.end(), shape.mesh.indices.begin(), shape.mesh.indices.end());
+  return mesh;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+inline size_t hardware_threads() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Worker threads behind parallel_for: started on first use, one less than the hardware threads since the calling
+// thread works too, and kept until exit sleeping on a condition variable, so a frame pays for no thread creation.
+// Any number of threads may run jobs at the same time (e.g. the FrameWriter thread encoding while the next frame
+// is rasterized), each job is a batch that helpers take from a queue.
+class ThreadPool {
+public:
+  static ThreadPool& instance() {
+    static ThreadPool pool(hardware_threads() - 1);
+    return pool;
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    available.notify_all();
+    for (auto& worker : workers)
+      worker.join();
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // True on the pool's own threads, where a nested parallel_for runs serially instead of waiting on its siblings
+  static bool on_worker() {
+    return worker_thread();
+  }
+
+  // Calls `job()` on the calling thread and on up to `helpers` workers at once and returns when all calls are done.
+  // `job` has to share out its work itself, helpers that only get to it late find nothing left.
+  template<class Job>
+  void run(size_t helpers, Job& job) {
+    Batch batch{ [](void* job) { (*static_cast<Job*>(job))(); }, &job, helpers };
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      queue.push_back(&batch);
+    }
+    available.notify_all();
+
+    job();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    // workers that haven't picked the batch up yet mustn't do so once it is gone from this stack frame
+    const auto queued = std::find(queue.begin(), queue.end(), &batch);
+    if (queued != queue.end())
+      queue.erase(queued);
+    finished.wait(lock, [&] { return batch.done == batch.taken; });
+  }
+
+private:
+  struct Batch {
+    void (*call)(void*);
+    void* job;
+    size_t helpers;
+    size_t taken = 0;
+    size_t done = 0;
+  };
+
+  explicit ThreadPool(size_t count) {
+    workers.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+      workers.emplace_back([this] { work(); });
+  }
+
+  static bool& worker_thread() {
+    static thread_local bool on_worker = false;
+    return on_worker;
+  }
+
+  void work() {
+    worker_thread() = true;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      available.wait(lock, [&] { return stopping || !queue.empty(); });
+      if (stopping)
+        return;
+
+      Batch* batch = queue.front();
+      if (++batch->taken == batch->helpers)
+        queue.pop_front();
+      lock.unlock();
+      batch->call(batch->job);
+      lock.lock();
+      if (++batch->done == batch->taken)
+        finished.notify_all();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable available;
+  std::condition_variable finished;
+  std::deque<Batch*> queue;
+  bool stopping = false;
+  std::vector<std::thread> workers;
+};
+
+// Calls `fn(i)` for every i in [0, count) spread over all hardware threads, the caller's and the ThreadPool's.
+// Indices are handed out one at a time so uneven work (e.g. busy screen tiles) balances itself.
+template<class Fn>
+inline void parallel_for(size_t count, Fn&& fn) {
+  const size_t thread_count = std::min(count, hardware_threads());
+  if (thread_count <= 1 || ThreadPool::on_worker()) {
+    for (size_t i = 0; i < count; ++i)
+      fn(i);
+    return;
+  }
+
+  std::atomic<size_t> next{ 0 };
+  auto worker = [&]() {
+    for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < count; i = next.fetch_add(1, std::memory_order_relaxed))
+      fn(i);
+  };
+  ThreadPool::instance().run(thread_count - 1, worker);
+}
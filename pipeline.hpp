@@ -0,0 +1,146 @@
+#pragma once
+
+#include "rasterization.hpp"
+#include "tga_color.hpp"
+#include "tgaimage.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+// Vertex layout handed out by load_model_and_for_each_face
+struct MeshVertex {
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec2 texcoord;
+};
+
+template<size_t N>
+using Varyings = std::array<float_t, N>;
+
+// Programmable triangle pipeline with the shaders resolved at compile time, every combination gets its own fully
+// inlined raster loop and there is no std::function or virtual call per pixel. The rasterizers of the lessons are
+// instantiations of it (see the end of shaders.hpp), all of them walk pixels with walk_triangle.
+//
+// A vertex shader declares how many floats it passes to the fragment shader and maps a vertex to screen space:
+//   static constexpr size_t VARYINGS = N;
+//   glm::vec3 operator()(const Vertex& vertex, Varyings<N>& out) const;   // x, y in pixels, z grows towards the viewer
+// A fragment shader gets the perspective-free interpolated varyings of a pixel that passed the depth test:
+//   bool operator()(const Varyings<N>& in, TGAColor& color) const;       // false discards the pixel
+// and may declare
+//   void begin(const Setup& setup, const std::array<Varyings<N>, 3>& varyings);   // once per triangle, before its pixels
+//   bool raster_avx2(screen_coords, varyings, z_buffer, image, clamp_min, clamp_max);  // 8-wide path of its own, false
+//                                                                                      // leaves the triangle to the loop
+// Uniforms are plain members of the shaders, reachable through vertex_shader() and fragment_shader().
+// `Setup` is TriangleSetup or FixedTriangleSetup, the latter snaps vertices and applies a top-left fill rule.
+template<class VertexShader, class FragmentShader, class Setup = TriangleSetup>
+class Pipeline {
+public:
+  static constexpr size_t VARYINGS = VertexShader::VARYINGS;
+  using TriangleVaryings = std::array<Varyings<VARYINGS>, 3>;
+
+  Pipeline(VertexShader vertex_shader = {}, FragmentShader fragment_shader = {})
+    : vs(vertex_shader)
+    , fs(fragment_shader) {
+  }
+
+  VertexShader& vertex_shader() { return vs; }
+  FragmentShader& fragment_shader() { return fs; }
+
+  template<class Vertex>
+  void draw(const std::array<Vertex, 3>& triangle, std::vector<float_t>& z_buffer, TGAImage& image) {
+    draw(triangle, z_buffer, image, glm::ivec2{ 0, 0 }, glm::ivec2{ image.get_width() - 1, image.get_height() - 1 });
+  }
+
+  // Only pixels inside [clamp_min, clamp_max] are touched
+  template<class Vertex>
+  void draw(const std::array<Vertex, 3>& triangle, std::vector<float_t>& z_buffer, TGAImage& image, glm::ivec2 clamp_min, glm::ivec2 clamp_max) {
+    std::array<glm::vec3, 3> screen_coords;
+    TriangleVaryings varyings;
+    for (size_t i = 0; i < 3; ++i)
+      screen_coords[i] = vs(triangle[i], varyings[i]);
+    raster(screen_coords, varyings, z_buffer, image, clamp_min, clamp_max);
+  }
+
+  // Without a depth test, later triangles paint over earlier ones
+  template<class Vertex>
+  void draw(const std::array<Vertex, 3>& triangle, TGAImage& image) {
+    std::array<glm::vec3, 3> screen_coords;
+    TriangleVaryings varyings;
+    for (size_t i = 0; i < 3; ++i)
+      screen_coords[i] = vs(triangle[i], varyings[i]);
+    raster_pixels<false>(screen_coords, varyings, nullptr, image, glm::ivec2{ 0, 0 }, glm::ivec2{ image.get_width() - 1, image.get_height() - 1 });
+  }
+
+  // The stages after the vertex shader, for triangles already in screen space
+  void raster(const std::array<glm::vec3, 3>& screen_coords, const TriangleVaryings& varyings, std::vector<float_t>& z_buffer, TGAImage& image,
+    glm::ivec2 clamp_min, glm::ivec2 clamp_max) {
+#if defined(__AVX2__)
+    if constexpr (std::is_same_v<Setup, TriangleSetup> && requires { fs.raster_avx2(screen_coords, varyings, z_buffer, image, clamp_min, clamp_max); }) {
+      if (fs.raster_avx2(screen_coords, varyings, z_buffer, image, clamp_min, clamp_max))
+        return;
+    }
+#endif
+    raster_scalar(screen_coords, varyings, z_buffer, image, clamp_min, clamp_max);
+  }
+
+  // raster one pixel at a time whatever the build, what an 8-wide path has to match
+  void raster_scalar(const std::array<glm::vec3, 3>& screen_coords, const TriangleVaryings& varyings, std::vector<float_t>& z_buffer, TGAImage& image,
+    glm::ivec2 clamp_min, glm::ivec2 clamp_max) {
+    raster_pixels<true>(screen_coords, varyings, &z_buffer, image, clamp_min, clamp_max);
+  }
+
+  void raster(const std::array<glm::vec3, 3>& screen_coords, const TriangleVaryings& varyings, TGAImage& image, glm::ivec2 clamp_min, glm::ivec2 clamp_max) {
+    raster_pixels<false>(screen_coords, varyings, nullptr, image, clamp_min, clamp_max);
+  }
+
+private:
+  template<bool DEPTH_TEST>
+  void raster_pixels(const std::array<glm::vec3, 3>& screen_coords, const TriangleVaryings& varyings, std::vector<float_t>* z_buffer, TGAImage& image,
+    glm::ivec2 clamp_min, glm::ivec2 clamp_max) {
+    auto& [a, b, c] = screen_coords;
+    const int32_t width = image.get_width();
+
+    Setup setup;
+    if constexpr (std::is_same_v<Setup, FixedTriangleSetup>) {
+      setup = setup_triangle_fixed(screen_coords, clamp_min, clamp_max);
+      if (setup.area == 0)
+        return;
+    } else {
+      setup = setup_triangle(screen_coords, clamp_min, clamp_max);
+      // dont forget that the area is integer. If it is zero then triangle ABC is degenerate
+      if (setup.area <= 1e-2)
+        return;
+    }
+    if constexpr (requires { fs.begin(setup, varyings); })
+      fs.begin(setup, varyings);
+
+    walk_triangle(setup, [&](int32_t x, int32_t y, glm::vec3 bc) {
+      const float_t z = a.z * bc.x + b.z * bc.y + c.z * bc.z;
+      const size_t depth_index = x + y * width;
+      if constexpr (DEPTH_TEST) {
+        if (!((*z_buffer)[depth_index] < z))
+          return;
+      }
+
+      Varyings<VARYINGS> interpolated;
+      for (size_t i = 0; i < VARYINGS; ++i)
+        interpolated[i] = varyings[0][i] * bc.x + varyings[1][i] * bc.y + varyings[2][i] * bc.z;
+
+      TGAColor color;
+      if (!fs(interpolated, color))
+        return;
+
+      if constexpr (DEPTH_TEST)
+        (*z_buffer)[depth_index] = z;
+      image.set(x, y, color);
+    });
+  }
+
+  VertexShader vs;
+  FragmentShader fs;
+};
@@ -1,15 +1,24 @@
 #pragma once
 
 #include "glm/geometric.hpp"
+#include "texture.hpp"
 #include "tga_color.hpp"
 #include "tgaimage.hpp"
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <limits>
 #include <tuple>
 #include <type_traits>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 
 template<class T>
 inline T lerp(T a, T b, float_t t) {
@@ -125,84 +134,417 @@ inline glm::vec3 barycentric(std::array<glm::vec3, 3> triangle, glm::vec3 P) {
   return glm::vec3(-1, 1, 1); // in this case generate negative coordinates, it will be thrown away by the rasterizator
 }
 
-inline void raster_triangle(std::array<glm::vec2, 3> triangle, TGAImage& image, const TGAColor& color) {
-  std::sort(triangle.begin(), triangle.end(), [](glm::vec2& a, glm::vec2& b) { return a.y > b.y; });
-  auto& [a, b, c] = triangle;
-
-  const glm::vec2 clamp_min{ 0, 0 };
-  const glm::vec2 clamp_max{ float_t(image.get_width()), float_t(image.get_height()) };
+// Edge functions of a triangle, set up once and then evaluated over the bounding box [min, max].
+// `origin` holds the edge values at `anchor`, the first pixel of the unclamped bounding box, stepping one pixel right
+// adds `step_x`, one pixel up adds `step_y`. The anchor doesn't move with the clamp rectangle, so a pixel gets the same
+// edge values whichever tile or block run it is rasterized in (see edge_values_at).
+// Components are ordered as the barycentric weights of A, B and C (scaled by `area`) so they interpolate like `barycentric`.
+// https://www.cs.drexel.edu/~david/Classes/Papers/comp175-06-pineda.pdf
+struct TriangleSetup {
+  glm::vec2 min;
+  glm::vec2 max;
+  glm::vec2 anchor;
+  glm::vec3 origin;
+  glm::vec3 step_x;
+  glm::vec3 step_y;
+  float_t area;
+  float_t inv_area;
+};
+
+template<class V>
+inline TriangleSetup setup_triangle(const std::array<V, 3>& triangle, glm::vec2 clamp_min, glm::vec2 clamp_max) {
+  const auto& [A, B, C] = triangle;
   auto [min, max] = bbox(triangle, clamp_min, clamp_max);
+  min = glm::ceil(min);
+  max = glm::floor(max);
+
+  TriangleSetup setup{};
+  setup.min = min;
+  setup.max = max;
+  setup.anchor = glm::ceil(glm::min(glm::min(glm::vec2(A), glm::vec2(B)), glm::vec2(C)));
+
+  // edge B->C weights A, edge C->A weights B, edge A->B weights C
+  setup.step_x = glm::vec3(C.y - B.y, A.y - C.y, B.y - A.y);
+  setup.step_y = glm::vec3(B.x - C.x, C.x - A.x, A.x - B.x);
+  setup.origin = glm::vec3(
+    setup.step_x[0] * (setup.anchor.x - B.x) + setup.step_y[0] * (setup.anchor.y - B.y),
+    setup.step_x[1] * (setup.anchor.x - A.x) + setup.step_y[1] * (setup.anchor.y - A.y),
+    setup.step_x[2] * (setup.anchor.x - A.x) + setup.step_y[2] * (setup.anchor.y - A.y)
+  );
+  setup.area = (C.x - A.x) * (B.y - A.y) - (B.x - A.x) * (C.y - A.y);
+
+  // make the inside of the triangle positive regardless of its winding
+  if (setup.area < 0) {
+    setup.origin = -setup.origin;
+    setup.step_x = -setup.step_x;
+    setup.step_y = -setup.step_y;
+    setup.area = -setup.area;
+  }
+  setup.inv_area = setup.area > 0 ? 1.0f / setup.area : 0.0f;
+  return setup;
+}
 
-  for (int32_t y = min.y; y <= max.y; ++y) {
-    for (int32_t x = min.x; x <= max.x; ++x) {
-      // auto [u, v] = barycentric_weights_of_a_point(triangle, glm::vec2{x, y}).raw;
-      // if (u + v > 1 || u < 0 || v < 0) continue;
-      // image.set(x, y, color);
+// Edge values of a row of pixels, evaluated from the anchor and never accumulated: sub-pixel vertices would make a
+// running sum drift away from what another rasterizer computes for the same pixel
+inline glm::vec3 edge_row(const TriangleSetup& setup, int32_t y) {
+  return setup.origin + float_t(y - setup.anchor.y) * setup.step_y;
+}
 
-      auto bc = barycentric(triangle, glm::vec2{ x, y });
-      const auto u = bc.x;
-      const auto v = bc.y;
-      const auto w = bc.z;
+// Edge values of any pixel, bit for bit what every floating point rasterizer walks
+inline glm::vec3 edge_values_at(const TriangleSetup& setup, int32_t x, int32_t y) {
+  return edge_row(setup, y) + float_t(x - setup.anchor.x) * setup.step_x;
+}
 
-      if (u < 0 || v < 0 || w < 0)
+// The pixel loop of the floating point rasterizers: calls `fragment(x, y, bc)` for every pixel of [min, max] inside
+// the triangle, `bc` being its barycentric weights
+template<class Fragment>
+inline void walk_triangle(const TriangleSetup& setup, Fragment&& fragment) {
+  for (int32_t y = setup.min.y; y <= setup.max.y; ++y) {
+    const glm::vec3 row = edge_row(setup, y);
+    for (int32_t x = setup.min.x; x <= setup.max.x; ++x) {
+      // edge_values_at, with the row hoisted
+      const glm::vec3 edge = row + float_t(x - setup.anchor.x) * setup.step_x;
+      if (edge.x < 0 || edge.y < 0 || edge.z < 0)
         continue;
-      image.set(x, y, color);
+      fragment(x, y, edge * setup.inv_area);
     }
   }
 }
 
-inline void raster_triangle_with_depth_buffer(
-  std::array<glm::vec3, 3>& triangle,
-  std::array<glm::vec2, 3>& texcoord,
+// Vertices snapped to 28.4 fixed point, edge functions are then evaluated exactly in integers.
+// Pixels are sampled at their integer coordinates like the floating point setup, pixels lying exactly on an edge
+// are owned by a single triangle through the top-left fill rule (`edge_min` is 0 for top/left edges, 1 otherwise).
+constexpr int32_t SUBPIXEL_BITS = 4;
+constexpr int32_t SUBPIXEL_ONE = 1 << SUBPIXEL_BITS;
+
+inline int32_t to_fixed(float_t v) {
+  return int32_t(std::lround(v * SUBPIXEL_ONE));
+}
+
+struct FixedTriangleSetup {
+  int32_t min_x;
+  int32_t min_y;
+  int32_t max_x;
+  int32_t max_y;
+  std::array<int64_t, 3> origin;
+  std::array<int64_t, 3> step_x;
+  std::array<int64_t, 3> step_y;
+  std::array<int64_t, 3> edge_min;
+  int64_t area;
+  float_t inv_area;
+};
+
+template<class V>
+inline FixedTriangleSetup setup_triangle_fixed(const std::array<V, 3>& triangle, glm::ivec2 clamp_min, glm::ivec2 clamp_max) {
+  int64_t xs[3], ys[3];
+  for (int i = 0; i < 3; i++) {
+    xs[i] = to_fixed(triangle[i].x);
+    ys[i] = to_fixed(triangle[i].y);
+  }
+
+  FixedTriangleSetup setup{};
+  // first and last pixel whose sample point is inside the bounding box, >> rounds towards negative infinity
+  setup.min_x = std::max<int64_t>(clamp_min.x, (std::min({ xs[0], xs[1], xs[2] }) + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS);
+  setup.min_y = std::max<int64_t>(clamp_min.y, (std::min({ ys[0], ys[1], ys[2] }) + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS);
+  setup.max_x = std::min<int64_t>(clamp_max.x, std::max({ xs[0], xs[1], xs[2] }) >> SUBPIXEL_BITS);
+  setup.max_y = std::min<int64_t>(clamp_max.y, std::max({ ys[0], ys[1], ys[2] }) >> SUBPIXEL_BITS);
+
+  setup.area = (xs[2] - xs[0]) * (ys[1] - ys[0]) - (xs[1] - xs[0]) * (ys[2] - ys[0]);
+  const int64_t winding = setup.area < 0 ? -1 : 1;
+  setup.area *= winding;
+  setup.inv_area = setup.area > 0 ? 1.0f / float_t(setup.area) : 0.0f;
+
+  // edge B->C weights A, edge C->A weights B, edge A->B weights C, same order as setup_triangle
+  const int edges[3][2] = { { 1, 2 }, { 2, 0 }, { 0, 1 } };
+  const int64_t px = int64_t(setup.min_x) << SUBPIXEL_BITS;
+  const int64_t py = int64_t(setup.min_y) << SUBPIXEL_BITS;
+  for (int i = 0; i < 3; i++) {
+    const auto [v0, v1] = edges[i];
+    const int64_t nx = (ys[v1] - ys[v0]) * winding;
+    const int64_t ny = (xs[v0] - xs[v1]) * winding;
+    setup.origin[i] = nx * (px - xs[v0]) + ny * (py - ys[v0]);
+    setup.step_x[i] = nx << SUBPIXEL_BITS;
+    setup.step_y[i] = ny << SUBPIXEL_BITS;
+    // (nx, ny) points inside, so a top edge has the inside below it (+y in buffer rows) and a left edge to its right
+    const bool top_left = nx > 0 || (nx == 0 && ny > 0);
+    setup.edge_min[i] = top_left ? 0 : 1;
+  }
+  return setup;
+}
+
+inline std::array<int64_t, 3> edge_values_at(const FixedTriangleSetup& setup, int32_t x, int32_t y) {
+  std::array<int64_t, 3> edge;
+  for (int i = 0; i < 3; i++)
+    edge[i] = setup.origin[i] + (x - setup.min_x) * setup.step_x[i] + (y - setup.min_y) * setup.step_y[i];
+  return edge;
+}
+
+// walk_triangle for the fixed point setup, integer edges can be summed up without drifting
+template<class Fragment>
+inline void walk_triangle(const FixedTriangleSetup& setup, Fragment&& fragment) {
+  std::array<int64_t, 3> row = setup.origin;
+  for (int32_t y = setup.min_y; y <= setup.max_y; ++y) {
+    std::array<int64_t, 3> edge = row;
+    for (int32_t x = setup.min_x; x <= setup.max_x; ++x) {
+      if (edge[0] >= setup.edge_min[0] && edge[1] >= setup.edge_min[1] && edge[2] >= setup.edge_min[2])
+        fragment(x, y, glm::vec3(edge[0], edge[1], edge[2]) * setup.inv_area);
+      for (int i = 0; i < 3; i++)
+        edge[i] += setup.step_x[i];
+    }
+    for (int i = 0; i < 3; i++)
+      row[i] += setup.step_y[i];
+  }
+}
+
+// Diffuse texture fetch scaled by a single light intensity, the shading model of the depth buffered rasterizers.
+// A plain TGAImage is sampled nearest at full resolution, `lod` only matters for a Texture2D.
+inline TGAColor shade_textured(TGAImage& texture, glm::vec2 uv, float light_intensity, float_t /*lod*/ = 0) {
+  int u = uv.x * texture.get_width();
+  int v = uv.y * texture.get_height();
+
+  auto color = texture.get(u, texture.row_from_bottom(v));
+  color.r *= light_intensity;
+  color.g *= light_intensity;
+  color.b *= light_intensity;
+  color.a = 255;
+  return color;
+}
+
+inline TGAColor shade_textured(const Texture2D& texture, glm::vec2 uv, float light_intensity, float_t lod) {
+  auto color = texture.sample(uv, lod);
+  color.r *= light_intensity;
+  color.g *= light_intensity;
+  color.b *= light_intensity;
+  color.a = 255;
+  return color;
+}
+
+// Texture coordinates interpolated with the barycentric weights `bc` first
+template<class Texture>
+inline TGAColor shade_textured(Texture& texture, const std::array<glm::vec2, 3>& texcoord, glm::vec3 bc, float light_intensity, float_t lod = 0) {
+  auto& [tex_a, tex_b, tex_c] = texcoord;
+  return shade_textured(texture, tex_a * bc.x + tex_b * bc.y + tex_c * bc.z, light_intensity, lod);
+}
+
+// Texture coordinates are interpolated affinely in screen space, so their derivatives and with them the mip level
+// are constant over a triangle. Works with both setups, their steps are in the units `inv_area` undoes.
+template<class Setup>
+inline float_t texture_lod(const Texture2D& texture, const Setup& setup, const std::array<glm::vec2, 3>& texcoord) {
+  glm::vec2 duv_dx{ 0 };
+  glm::vec2 duv_dy{ 0 };
+  for (int i = 0; i < 3; ++i) {
+    duv_dx += texcoord[i] * float_t(setup.step_x[i]);
+    duv_dy += texcoord[i] * float_t(setup.step_y[i]);
+  }
+  return texture.lod(duv_dx * setup.inv_area, duv_dy * setup.inv_area);
+}
+
+template<class Setup>
+inline float_t texture_lod(TGAImage&, const Setup&, const std::array<glm::vec2, 3>&) {
+  return 0;
+}
+
+#if defined(__AVX2__)
+// raster_triangle_with_depth_buffer_scalar (shaders.hpp) walking a row 8 pixels at a time: coverage, depth test and
+// texel fetch are done for all lanes at once, only the store of the surviving pixels is per lane. TexturedFragmentShader
+// hands its triangles here on AVX2 builds.
+// Edge values of a lane are evaluated as edge_values_at does like in the scalar path, so both write the same bytes
+// (tests/rasterization_avx2_test.cpp).
+// Returns false without touching anything for the grayscale and missing textures it leaves to the scalar path.
+inline bool raster_triangle_with_depth_buffer_avx2(
+  const std::array<glm::vec3, 3>& triangle,
+  const std::array<glm::vec2, 3>& texcoord,
   std::vector<float_t>& z_buffer,
   TGAImage& image,
   TGAImage& texture,
-  float light_intensity
+  float light_intensity,
+  glm::vec2 clamp_min,
+  glm::vec2 clamp_max
 ) {
-  //std::sort(triangle.begin(), triangle.end(), [](glm::vec3& a, glm::vec3& b) { return a.y > b.y; });
+  const int32_t tex_bytespp = texture.get_bytespp();
+  // grayscale textures and missing textures are rare enough to take the scalar path
+  if (tex_bytespp < TGAImage::RGB || !texture.buffer())
+    return false;
+
   auto& [a, b, c] = triangle;
   auto& [tex_a, tex_b, tex_c] = texcoord;
-  const float_t width = image.get_width();
-  const float_t height = image.get_height();
-
-  constexpr glm::vec2 clamp_min{ 0, 0 };
-  const glm::vec2 clamp_max{ width, height };
-  auto [min, max] = bbox(triangle, clamp_min, clamp_max);
-
-  float_t z = 0;
-
-  for (float_t y = min.y; y <= max.y; ++y) {
-    for (float_t x = min.x; x <= max.x; ++x) {
-      auto bc = barycentric(triangle, glm::vec3(x, y, z));
-
-      // barycentric U/X screen coordinate
-      const auto bcx = bc.x;
-      // barycentric V/Y screen coordinate
-      const auto bcy = bc.y;
-      // barycentric W/Z screen coordinate
-      const auto bcz = bc.z;
-
-      if (bcx < 0 || bcy < 0 || bcz < 0)
+  const int32_t width = image.get_width();
+  const int32_t bytespp = image.get_bytespp();
+  const int32_t tex_width = texture.get_width();
+  const int32_t tex_height = texture.get_height();
+  const unsigned char* tex_data = texture.buffer();
+  // 32 bit gathers read one byte past an RGB texel, texels closer than 4 bytes to the end are fetched per lane
+  const int32_t tex_gather_limit = tex_width * tex_height * tex_bytespp - 4;
+
+  const TriangleSetup setup = setup_triangle(triangle, clamp_min, clamp_max);
+
+  // dont forget that the area is integer. If it is zero then triangle ABC is degenerate
+  if (setup.area <= 1e-2)
+    return true;
+
+  const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256i lane_i = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 step_x0 = _mm256_set1_ps(setup.step_x.x);
+  const __m256 step_x1 = _mm256_set1_ps(setup.step_x.y);
+  const __m256 step_x2 = _mm256_set1_ps(setup.step_x.z);
+  const __m256 inv_area = _mm256_set1_ps(setup.inv_area);
+  const __m256 az = _mm256_set1_ps(a.z);
+  const __m256 bz = _mm256_set1_ps(b.z);
+  const __m256 cz = _mm256_set1_ps(c.z);
+  const __m256 tex_ax = _mm256_set1_ps(tex_a.x);
+  const __m256 tex_bx = _mm256_set1_ps(tex_b.x);
+  const __m256 tex_cx = _mm256_set1_ps(tex_c.x);
+  const __m256 tex_ay = _mm256_set1_ps(tex_a.y);
+  const __m256 tex_by = _mm256_set1_ps(tex_b.y);
+  const __m256 tex_cy = _mm256_set1_ps(tex_c.y);
+  const __m256 tex_width_f = _mm256_set1_ps(float(tex_width));
+  const __m256 tex_height_f = _mm256_set1_ps(float(tex_height));
+  const __m256i tex_width_i = _mm256_set1_epi32(tex_width);
+  const __m256i tex_height_i = _mm256_set1_epi32(tex_height);
+  const __m256i tex_bytespp_i = _mm256_set1_epi32(tex_bytespp);
+  // v goes up from the bottom, for a top-left texture the stored row is (height - 1) - v, i.e. base + (v ^ -1) + 1
+  const bool tex_top_left = texture.get_origin() == TGAImage::TOP_LEFT;
+  const __m256i tex_row_flip = _mm256_set1_epi32(tex_top_left ? -1 : 0);
+  const __m256i tex_row_base = _mm256_set1_epi32(tex_top_left ? tex_height - 1 : 0);
+  const __m256i tex_gather_limit_i = _mm256_set1_epi32(tex_gather_limit);
+  const __m256i minus_one = _mm256_set1_epi32(-1);
+  const __m256i channel_mask = _mm256_set1_epi32(0xFF);
+  const __m256i alpha = _mm256_set1_epi32(0xFF000000);
+  const __m256 intensity = _mm256_set1_ps(light_intensity);
+
+  alignas(32) uint32_t colors[8];
+  alignas(32) int32_t us[8];
+  alignas(32) int32_t vs[8];
+
+  const int32_t min_x = setup.min.x;
+  const int32_t max_x = setup.max.x;
+  for (int32_t y = setup.min.y; y <= setup.max.y; ++y) {
+    const glm::vec3 row = edge_row(setup, y);
+    const __m256 row0 = _mm256_set1_ps(row.x);
+    const __m256 row1 = _mm256_set1_ps(row.y);
+    const __m256 row2 = _mm256_set1_ps(row.z);
+
+    for (int32_t x = min_x; x <= max_x; x += 8) {
+      const __m256 dx = _mm256_add_ps(_mm256_set1_ps(float_t(x - setup.anchor.x)), lane);
+      const __m256 edge0 = _mm256_add_ps(row0, _mm256_mul_ps(dx, step_x0));
+      const __m256 edge1 = _mm256_add_ps(row1, _mm256_mul_ps(dx, step_x1));
+      const __m256 edge2 = _mm256_add_ps(row2, _mm256_mul_ps(dx, step_x2));
+
+      // lanes past the end of the span are masked out, "not less than" keeps NaN edges like the scalar `< 0` test
+      __m256 covered = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(max_x - x + 1), lane_i));
+      covered = _mm256_and_ps(covered, _mm256_cmp_ps(edge0, zero, _CMP_NLT_UQ));
+      covered = _mm256_and_ps(covered, _mm256_cmp_ps(edge1, zero, _CMP_NLT_UQ));
+      covered = _mm256_and_ps(covered, _mm256_cmp_ps(edge2, zero, _CMP_NLT_UQ));
+      if (_mm256_testz_ps(covered, covered))
         continue;
 
-      z = a.z * bcx + b.z * bcy + c.z * bcz;
+      const __m256 bc0 = _mm256_mul_ps(edge0, inv_area);
+      const __m256 bc1 = _mm256_mul_ps(edge1, inv_area);
+      const __m256 bc2 = _mm256_mul_ps(edge2, inv_area);
 
-      int depth_index = size_t(x + y * width);
-      if (z_buffer[depth_index] < z) {
-        
-        z_buffer[depth_index] = z;
+      const __m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(az, bc0), _mm256_mul_ps(bz, bc1)), _mm256_mul_ps(cz, bc2));
 
-        int u = ((tex_a.x * bcx) + (tex_b.x * bcy) + (tex_c.x * bcz)) * texture.get_width();
-        int v = ((tex_a.y * bcx) + (tex_b.y * bcy) + (tex_c.y * bcz)) * texture.get_height();
-        
-        auto color = texture.get(u, v);
-        color.r *= light_intensity;
-        color.g *= light_intensity;
-        color.b *= light_intensity;
-        color.a = 255;
+      float_t* depth = z_buffer.data() + x + size_t(y) * width;
+      const __m256 z_old = _mm256_maskload_ps(depth, _mm256_castps_si256(covered));
+      const __m256 pass = _mm256_and_ps(covered, _mm256_cmp_ps(z_old, z, _CMP_LT_OQ));
+      uint32_t mask = _mm256_movemask_ps(pass);
+      if (!mask)
+        continue;
+      _mm256_maskstore_ps(depth, _mm256_castps_si256(pass), z);
+
+      const __m256 u_f = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tex_ax, bc0), _mm256_mul_ps(tex_bx, bc1)), _mm256_mul_ps(tex_cx, bc2)), tex_width_f);
+      const __m256 v_f = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tex_ay, bc0), _mm256_mul_ps(tex_by, bc1)), _mm256_mul_ps(tex_cy, bc2)), tex_height_f);
+      const __m256i u = _mm256_cvttps_epi32(u_f);
+      const __m256i v = _mm256_cvttps_epi32(v_f);
+
+      // TGAImage::get() returns black outside of the texture
+      __m256i inside = _mm256_and_si256(_mm256_cmpgt_epi32(u, minus_one), _mm256_cmpgt_epi32(v, minus_one));
+      inside = _mm256_and_si256(inside, _mm256_cmpgt_epi32(tex_width_i, u));
+      inside = _mm256_and_si256(inside, _mm256_cmpgt_epi32(tex_height_i, v));
+      inside = _mm256_and_si256(inside, _mm256_castps_si256(pass));
+
+      const __m256i tex_row = _mm256_add_epi32(tex_row_base, _mm256_sub_epi32(_mm256_xor_si256(v, tex_row_flip), tex_row_flip));
+      const __m256i offset = _mm256_mullo_epi32(_mm256_add_epi32(u, _mm256_mullo_epi32(tex_row, tex_width_i)), tex_bytespp_i);
+      const __m256i gather = _mm256_andnot_si256(_mm256_cmpgt_epi32(offset, tex_gather_limit_i), inside);
+      __m256i texel = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)tex_data, offset, gather, 1);
+
+      const __m256i blue = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(texel, channel_mask)), intensity));
+      const __m256i green = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texel, 8), channel_mask)), intensity));
+      const __m256i red = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(texel, 16), channel_mask)), intensity));
+      texel = _mm256_or_si256(_mm256_or_si256(blue, _mm256_slli_epi32(green, 8)), _mm256_or_si256(_mm256_slli_epi32(red, 16), alpha));
+
+      _mm256_store_si256((__m256i*)colors, texel);
+      const uint32_t per_lane_mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_andnot_si256(gather, inside)));
+      if (per_lane_mask) {
+        _mm256_store_si256((__m256i*)us, u);
+        _mm256_store_si256((__m256i*)vs, tex_row);
+      }
 
-        image.set(x, y, color);
+      for (; mask; mask &= mask - 1) {
+        const int i = std::countr_zero(mask);
+        TGAColor color(colors[i], bytespp);
+        if (per_lane_mask & (1u << i)) {
+          color = texture.get(us[i], vs[i]);
+          color.r *= light_intensity;
+          color.g *= light_intensity;
+          color.b *= light_intensity;
+          color.a = 255;
+        }
+        image.set(x + i, y, color);
       }
     }
   }
+  return true;
+}
+#endif
+
+// Depth only pass of the visibility buffer: the id of the nearest triangle is stored instead of its shaded color
+inline void raster_triangle_visibility(
+  const std::array<glm::vec3, 3>& triangle,
+  uint32_t id,
+  std::vector<float_t>& z_buffer,
+  std::vector<uint32_t>& ids,
+  int32_t width,
+  glm::vec2 clamp_min,
+  glm::vec2 clamp_max
+) {
+  auto& [a, b, c] = triangle;
+  const TriangleSetup setup = setup_triangle(triangle, clamp_min, clamp_max);
+  if (setup.area <= 1e-2)
+    return;
+
+  // walked like the forward path, so the ids end up where its colors do and the resolve gets the same weights
+  walk_triangle(setup, [&](int32_t x, int32_t y, glm::vec3 bc) {
+    const float_t z = a.z * bc.x + b.z * bc.y + c.z * bc.z;
+    const size_t depth_index = x + y * width;
+    if (z_buffer[depth_index] < z) {
+      z_buffer[depth_index] = z;
+      ids[depth_index] = id;
+    }
+  });
+}
+
+inline void raster_triangle_visibility_fixed(
+  const std::array<glm::vec3, 3>& triangle,
+  uint32_t id,
+  std::vector<float_t>& z_buffer,
+  std::vector<uint32_t>& ids,
+  int32_t width,
+  glm::ivec2 clamp_min,
+  glm::ivec2 clamp_max
+) {
+  auto& [a, b, c] = triangle;
+  const FixedTriangleSetup setup = setup_triangle_fixed(triangle, clamp_min, clamp_max);
+  if (setup.area == 0)
+    return;
+
+  walk_triangle(setup, [&](int32_t x, int32_t y, glm::vec3 bc) {
+    const float_t z = a.z * bc.x + b.z * bc.y + c.z * bc.z;
+    const size_t depth_index = x + y * width;
+    if (z_buffer[depth_index] < z) {
+      z_buffer[depth_index] = z;
+      ids[depth_index] = id;
+    }
+  });
 }
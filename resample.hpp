@@ -0,0 +1,290 @@
+#pragma once
+
+#include "parallel.hpp"
+#include "tgaimage.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <numbers>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Separable image resize for thumbnails and supersample resolves: a horizontal pass into a float image
+// dst_width x src_height, then a vertical pass into the destination, each over bands of rows on all hardware threads.
+// The filter weights of every destination column and row and the float image in between are set up once, so a
+// Resampler kept across frames (e.g. resolving every frame of a 2x supersampled render) costs nothing to set up again.
+// When shrinking the filters are stretched to the source pixels a destination pixel covers, so BOX resolves an
+// integer factor to the exact average and nothing aliases. Pixels are handled as four floats (GRAYSCALE uses
+// the first), RGBA is resampled with premultiplied alpha so transparent pixels don't bleed their color.
+// Rows are resampled as stored, the destination gets the source's origin.
+class Resampler {
+public:
+  enum Filter {
+    BOX,
+    // tent, linear interpolation when enlarging
+    BILINEAR,
+    // windowed sinc with three lobes, the sharpest, may ring a little at hard edges
+    LANCZOS
+  };
+
+  Resampler(int src_width, int src_height, int dst_width, int dst_height, Filter filter = LANCZOS)
+    : src_width(src_width)
+    , src_height(src_height)
+    , dst_width(dst_width)
+    , dst_height(dst_height)
+    , horizontal(make_kernel(src_width, dst_width, filter))
+    , vertical(make_kernel(src_height, dst_height, filter)) {
+  }
+
+  // `src` has to be src_width x src_height, false and `dst` left alone otherwise. `dst` is reallocated unless it
+  // already is dst_width x dst_height with the bytespp of `src`.
+  bool resample(TGAImage& src, TGAImage& dst) {
+    const int bytespp = src.get_bytespp();
+    if (!src.buffer() || src.get_width() != src_width || src.get_height() != src_height
+      || (bytespp != TGAImage::GRAYSCALE && bytespp != TGAImage::RGB && bytespp != TGAImage::RGBA))
+      return false;
+    if (dst.get_width() != dst_width || dst.get_height() != dst_height || dst.get_bytespp() != bytespp)
+      dst = TGAImage(dst_width, dst_height, bytespp);
+    dst.set_origin(src.get_origin());
+    between.resize(size_t(dst_width) * src_height * 4);
+    if (bytespp == TGAImage::GRAYSCALE)
+      run<TGAImage::GRAYSCALE>(src.buffer(), dst.buffer());
+    else if (bytespp == TGAImage::RGB)
+      run<TGAImage::RGB>(src.buffer(), dst.buffer());
+    else
+      run<TGAImage::RGBA>(src.buffer(), dst.buffer());
+    return true;
+  }
+
+private:
+  // Destination pixel i takes `taps` source pixels from first[i] on, weighted by weights[i * taps + k].
+  // Windows near the edges are moved inside the image and padded with zero weights, so every one has all its taps.
+  struct Kernel {
+    int taps;
+    std::vector<int> first;
+    std::vector<float> weights;
+  };
+
+  static float weight(Filter filter, float x) {
+    x = std::abs(x);
+    switch (filter) {
+    case BOX:
+      return x <= 0.5f ? 1.0f : 0.0f;
+    case BILINEAR:
+      return std::max(0.0f, 1.0f - x);
+    case LANCZOS: {
+      if (x >= 3.0f)
+        return 0.0f;
+      if (x < 1e-6f)
+        return 1.0f;
+      const float pi_x = std::numbers::pi_v<float> * x;
+      return 3.0f * std::sin(pi_x) * std::sin(pi_x / 3.0f) / (pi_x * pi_x);
+    }
+    }
+    return 0.0f;
+  }
+
+  static float radius(Filter filter) { return filter == BOX ? 0.5f : filter == BILINEAR ? 1.0f : 3.0f; }
+
+  static Kernel make_kernel(int src_size, int dst_size, Filter filter) {
+    // source pixels per destination pixel, the filter is stretched by it when shrinking
+    const float step = float(src_size) / dst_size;
+    const float stretch = std::max(step, 1.0f);
+    const float support = radius(filter) * stretch;
+
+    Kernel kernel;
+    kernel.taps = std::min(src_size, int(std::ceil(support * 2)) + 1);
+    kernel.first.resize(dst_size);
+    kernel.weights.assign(size_t(dst_size) * kernel.taps, 0.0f);
+    for (int i = 0; i < dst_size; ++i) {
+      // pixel centers sit at half integers, the window starts at the first one the support may reach
+      const float center = (i + 0.5f) * step;
+      const int first = std::clamp(int(std::floor(center - support)), 0, src_size - kernel.taps);
+      float* weights = kernel.weights.data() + size_t(i) * kernel.taps;
+      float sum = 0;
+      for (int k = 0; k < kernel.taps; ++k) {
+        weights[k] = weight(filter, (first + k + 0.5f - center) / stretch);
+        sum += weights[k];
+      }
+      // a box narrower than a pixel can fall between centers, the nearest pixel is taken then
+      if (sum == 0) {
+        const int nearest = std::clamp(int(center), first, first + kernel.taps - 1);
+        weights[nearest - first] = sum = 1;
+      }
+      for (int k = 0; k < kernel.taps; ++k)
+        weights[k] /= sum;
+      kernel.first[i] = first;
+    }
+    return kernel;
+  }
+
+  // Bands of rows are few enough to hand out cheaply and long enough for the threads not to share cache lines
+  template<class Fn>
+  static void for_each_band(int rows, Fn&& fn) {
+    const int band_rows = 16;
+    parallel_for((rows + band_rows - 1) / band_rows, [&](size_t band) {
+      const int y_begin = int(band) * band_rows;
+      fn(y_begin, std::min(rows, y_begin + band_rows));
+    });
+  }
+
+  template<int bytespp>
+  void run(const unsigned char* in, unsigned char* out) {
+    for_each_band(src_height, [&](int y_begin, int y_end) {
+      std::vector<float> row(size_t(src_width) * 4);
+      for (int y = y_begin; y < y_end; ++y) {
+        load_row<bytespp>(in + size_t(y) * src_width * bytespp, row.data());
+        filter_row(row.data(), between.data() + size_t(y) * dst_width * 4);
+      }
+    });
+
+    for_each_band(dst_height, [&](int y_begin, int y_end) {
+      std::vector<float> row(size_t(dst_width) * 4);
+      for (int y = y_begin; y < y_end; ++y) {
+        filter_column(y, row.data());
+        store_row<bytespp>(row.data(), out + size_t(y) * dst_width * bytespp);
+      }
+    });
+  }
+
+  // BGR(A) bytes to four floats per pixel, alpha premultiplied
+  template<int bytespp>
+  void load_row(const unsigned char* in, float* row) const {
+    int x = 0;
+#if defined(__SSE2__)
+    if (bytespp != TGAImage::GRAYSCALE) {
+      const __m128i zero = _mm_setzero_si128();
+      const __m128 color_lanes = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+      const __m128 opaque = _mm_setr_ps(0, 0, 0, 255.0f);
+      const __m128 alpha_lane = _mm_setr_ps(0, 0, 0, 1);
+      // four bytes are read for an RGB pixel too, the last one of the row is left to the loop below
+      for (; x < src_width - 1; ++x, in += bytespp, row += 4) {
+        int bytes;
+        memcpy(&bytes, in, 4);
+        __m128 pixel = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero));
+        if (bytespp == TGAImage::RGB) {
+          pixel = _mm_or_ps(_mm_and_ps(pixel, color_lanes), opaque);
+        } else {
+          const __m128 alpha = _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(3, 3, 3, 3));
+          const __m128 premultiply = _mm_mul_ps(alpha, _mm_set1_ps(1.0f / 255.0f));
+          pixel = _mm_mul_ps(pixel, _mm_or_ps(_mm_and_ps(premultiply, color_lanes), alpha_lane));
+        }
+        _mm_storeu_ps(row, pixel);
+      }
+    }
+#endif
+    for (; x < src_width; ++x, in += bytespp, row += 4) {
+      if (bytespp == TGAImage::GRAYSCALE) {
+        row[0] = in[0];
+        row[1] = row[2] = row[3] = 0;
+        continue;
+      }
+      const float alpha = bytespp == TGAImage::RGBA ? in[3] : 255.0f;
+      const float premultiply = alpha * (1.0f / 255.0f);
+      row[0] = in[0] * premultiply;
+      row[1] = in[1] * premultiply;
+      row[2] = in[2] * premultiply;
+      row[3] = alpha;
+    }
+  }
+
+  // Rounded and saturated back to bytes, RGBA divided by its alpha again (a fully transparent pixel turns black)
+  template<int bytespp>
+  void store_row(const float* row, unsigned char* out) const {
+#if defined(__SSE2__)
+    const __m128 color_lanes = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    const __m128 alpha_lane = _mm_setr_ps(0, 0, 0, 1);
+    for (int x = 0; x < dst_width; ++x, row += 4, out += bytespp) {
+      __m128 pixel = _mm_loadu_ps(row);
+      if (bytespp == TGAImage::RGBA) {
+        const __m128 alpha = _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(3, 3, 3, 3));
+        const __m128 unpremultiply = _mm_and_ps(_mm_div_ps(_mm_set1_ps(255.0f), alpha), _mm_cmpgt_ps(alpha, _mm_set1_ps(0.5f)));
+        pixel = _mm_mul_ps(pixel, _mm_or_ps(_mm_and_ps(unpremultiply, color_lanes), alpha_lane));
+      }
+      const __m128i words = _mm_packs_epi32(_mm_cvtps_epi32(pixel), _mm_setzero_si128());
+      const int packed = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+      memcpy(out, &packed, bytespp);
+    }
+#else
+    for (int x = 0; x < dst_width; ++x, row += 4, out += bytespp) {
+      float pixel[4] = { row[0], row[1], row[2], row[3] };
+      if (bytespp == TGAImage::RGBA) {
+        const float unpremultiply = pixel[3] > 0.5f ? 255.0f / pixel[3] : 0.0f;
+        for (int c = 0; c < 3; ++c)
+          pixel[c] *= unpremultiply;
+      }
+      for (int c = 0; c < bytespp; ++c)
+        out[c] = (unsigned char)std::clamp(std::lrint(pixel[c]), 0l, 255l);
+    }
+#endif
+  }
+
+  void filter_row(const float* row, float* out) const {
+    const int taps = horizontal.taps;
+    for (int x = 0; x < dst_width; ++x, out += 4) {
+      const float* in = row + size_t(horizontal.first[x]) * 4;
+      const float* weights = horizontal.weights.data() + size_t(x) * taps;
+#if defined(__SSE2__)
+      // two sums keep wide kernels from waiting on one chain of dependent adds
+      __m128 even = _mm_setzero_ps();
+      __m128 odd = _mm_setzero_ps();
+      int k = 0;
+      for (; k + 1 < taps; k += 2) {
+        even = _mm_add_ps(even, _mm_mul_ps(_mm_loadu_ps(in + 4 * k), _mm_set1_ps(weights[k])));
+        odd = _mm_add_ps(odd, _mm_mul_ps(_mm_loadu_ps(in + 4 * k + 4), _mm_set1_ps(weights[k + 1])));
+      }
+      if (k < taps)
+        even = _mm_add_ps(even, _mm_mul_ps(_mm_loadu_ps(in + 4 * k), _mm_set1_ps(weights[k])));
+      _mm_storeu_ps(out, _mm_add_ps(even, odd));
+#else
+      float sum[4] = {};
+      for (int k = 0; k < taps; ++k)
+        for (int c = 0; c < 4; ++c)
+          sum[c] += in[4 * k + c] * weights[k];
+      memcpy(out, sum, sizeof(sum));
+#endif
+    }
+  }
+
+  // Destination row y as the weighted sum of whole rows of the horizontal pass, contiguous floats all the way
+  void filter_column(int y, float* out) const {
+    const size_t length = size_t(dst_width) * 4;
+    const int taps = vertical.taps;
+    const float* weights = vertical.weights.data() + size_t(y) * taps;
+    std::fill(out, out + length, 0.0f);
+    for (int k = 0; k < taps; ++k) {
+      if (weights[k] == 0)
+        continue;
+      const float* in = between.data() + size_t(vertical.first[y] + k) * length;
+#if defined(__SSE2__)
+      const __m128 w = _mm_set1_ps(weights[k]);
+      for (size_t i = 0; i < length; i += 4)
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), w)));
+#else
+      for (size_t i = 0; i < length; ++i)
+        out[i] += in[i] * weights[k];
+#endif
+    }
+  }
+
+  int src_width;
+  int src_height;
+  int dst_width;
+  int dst_height;
+  Kernel horizontal;
+  Kernel vertical;
+  // dst_width x src_height, four floats a pixel
+  std::vector<float> between;
+};
+
+// `image` resized to width x height
+inline TGAImage resample(TGAImage& image, int width, int height, Resampler::Filter filter = Resampler::LANCZOS) {
+  TGAImage result(width, height, image.get_bytespp(), image.get_origin());
+  Resampler(image.get_width(), image.get_height(), width, height, filter).resample(image, result);
+  return result;
+}
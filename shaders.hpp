@@ -0,0 +1,180 @@
+#pragma once
+
+#include "pipeline.hpp"
+#include "rasterization.hpp"
+#include "tga_color.hpp"
+#include "tgaimage.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Shaders for Pipeline, see pipeline.hpp for the interface they implement
+
+// Orthographic model to screen transform of the depth buffer lessons, nothing is interpolated
+struct ScreenVertexShader {
+  static constexpr size_t VARYINGS = 0;
+  size_t width;
+  size_t height;
+
+  glm::vec3 operator()(const MeshVertex& vertex, Varyings<VARYINGS>&) const {
+    return world_to_screen(vertex.position, width, height);
+  }
+};
+
+// One color for the whole triangle, e.g. lit by the face normal on the CPU side
+struct FlatFragmentShader {
+  TGAColor color;
+
+  bool operator()(const Varyings<0>&, TGAColor& out) const {
+    out = color;
+    return true;
+  }
+};
+
+// Diffuse lighting evaluated per vertex from the vertex normals and interpolated across the triangle
+struct GouraudVertexShader {
+  static constexpr size_t VARYINGS = 1;
+  size_t width;
+  size_t height;
+  glm::vec3 light_dir;
+  float_t ambient;
+
+  glm::vec3 operator()(const MeshVertex& vertex, Varyings<VARYINGS>& out) const {
+    out[0] = glm::clamp(glm::dot(glm::normalize(vertex.normal), light_dir) + ambient, 0.0f, 1.0f);
+    return world_to_screen(vertex.position, width, height);
+  }
+};
+
+struct GouraudFragmentShader {
+  TGAColor color;
+
+  bool operator()(const Varyings<1>& in, TGAColor& out) const {
+    out = color * in[0];
+    out.a = 255;
+    return true;
+  }
+};
+
+// Passes the texture coordinates through for TexturedFragmentShader
+struct TexturedVertexShader {
+  static constexpr size_t VARYINGS = 2;
+  size_t width;
+  size_t height;
+
+  glm::vec3 operator()(const MeshVertex& vertex, Varyings<VARYINGS>& out) const {
+    out[0] = vertex.texcoord.x;
+    out[1] = vertex.texcoord.y;
+    return world_to_screen(vertex.position, width, height);
+  }
+};
+
+// Diffuse texture times one light intensity per triangle, `Texture` is a TGAImage or a Texture2D
+template<class Texture>
+struct TexturedFragmentShader {
+  Texture* texture;
+  float_t light_intensity;
+  // mip level of the triangle being drawn
+  float_t lod = 0;
+
+  // texture coordinates are affine in screen space, so one mip level serves the whole triangle
+  template<class Setup>
+  void begin(const Setup& setup, const std::array<Varyings<2>, 3>& varyings) {
+    lod = texture_lod(*texture, setup, texcoords(varyings));
+  }
+
+  bool operator()(const Varyings<2>& in, TGAColor& out) const {
+    out = shade_textured(*texture, glm::vec2(in[0], in[1]), light_intensity, lod);
+    return true;
+  }
+
+#if defined(__AVX2__)
+  bool raster_avx2(const std::array<glm::vec3, 3>& screen_coords, const std::array<Varyings<2>, 3>& varyings, std::vector<float_t>& z_buffer,
+    TGAImage& image, glm::ivec2 clamp_min, glm::ivec2 clamp_max) const requires std::is_same_v<Texture, TGAImage> {
+    return raster_triangle_with_depth_buffer_avx2(screen_coords, texcoords(varyings), z_buffer, image, *texture, light_intensity, clamp_min, clamp_max);
+  }
+#endif
+
+  static std::array<glm::vec2, 3> texcoords(const std::array<Varyings<2>, 3>& varyings) {
+    return { glm::vec2(varyings[0][0], varyings[0][1]), glm::vec2(varyings[1][0], varyings[1][1]), glm::vec2(varyings[2][0], varyings[2][1]) };
+  }
+
+  static std::array<Varyings<2>, 3> from_texcoords(const std::array<glm::vec2, 3>& texcoords) {
+    return { Varyings<2>{ texcoords[0].x, texcoords[0].y }, Varyings<2>{ texcoords[1].x, texcoords[1].y }, Varyings<2>{ texcoords[2].x, texcoords[2].y } };
+  }
+};
+
+// The rasterizers of the lessons, for triangles already in screen space. Their pipelines skip the vertex stage.
+
+inline void raster_triangle(std::array<glm::vec2, 3> triangle, TGAImage& image, const TGAColor& color) {
+  Pipeline<ScreenVertexShader, FlatFragmentShader> pipeline({}, { color });
+  const std::array<glm::vec3, 3> screen_coords{ glm::vec3(triangle[0], 0), glm::vec3(triangle[1], 0), glm::vec3(triangle[2], 0) };
+  pipeline.raster(screen_coords, {}, image, glm::ivec2{ 0, 0 }, glm::ivec2{ image.get_width() - 1, image.get_height() - 1 });
+}
+
+// One pixel at a time whatever the build. Only pixels inside [clamp_min, clamp_max] are touched, which lets screen
+// tiles be rasterized independently.
+template<class Texture>
+inline void raster_triangle_with_depth_buffer_scalar(
+  const std::array<glm::vec3, 3>& triangle,
+  const std::array<glm::vec2, 3>& texcoord,
+  std::vector<float_t>& z_buffer,
+  TGAImage& image,
+  Texture& texture,
+  float light_intensity,
+  glm::vec2 clamp_min,
+  glm::vec2 clamp_max
+) {
+  Pipeline<TexturedVertexShader, TexturedFragmentShader<Texture>> pipeline({}, { &texture, light_intensity });
+  pipeline.raster_scalar(triangle, TexturedFragmentShader<Texture>::from_texcoords(texcoord), z_buffer, image, clamp_min, clamp_max);
+}
+
+// raster_triangle_with_depth_buffer_scalar, 8 pixels at a time when the build targets AVX2 (see TINY_RENDERER_AVX2 in
+// CMakeLists.txt) and the texture is a TGAImage
+template<class Texture>
+inline void raster_triangle_with_depth_buffer(
+  const std::array<glm::vec3, 3>& triangle,
+  const std::array<glm::vec2, 3>& texcoord,
+  std::vector<float_t>& z_buffer,
+  TGAImage& image,
+  Texture& texture,
+  float light_intensity,
+  glm::vec2 clamp_min,
+  glm::vec2 clamp_max
+) {
+  Pipeline<TexturedVertexShader, TexturedFragmentShader<Texture>> pipeline({}, { &texture, light_intensity });
+  pipeline.raster(triangle, TexturedFragmentShader<Texture>::from_texcoords(texcoord), z_buffer, image, clamp_min, clamp_max);
+}
+
+template<class Texture>
+inline void raster_triangle_with_depth_buffer(
+  const std::array<glm::vec3, 3>& triangle,
+  const std::array<glm::vec2, 3>& texcoord,
+  std::vector<float_t>& z_buffer,
+  TGAImage& image,
+  Texture& texture,
+  float light_intensity
+) {
+  const glm::vec2 clamp_min{ 0, 0 };
+  const glm::vec2 clamp_max{ image.get_width() - 1, image.get_height() - 1 };
+  raster_triangle_with_depth_buffer(triangle, texcoord, z_buffer, image, texture, light_intensity, clamp_min, clamp_max);
+}
+
+// Fixed point counterpart of raster_triangle_with_depth_buffer_scalar, see setup_triangle_fixed
+template<class Texture>
+inline void raster_triangle_with_depth_buffer_fixed(
+  const std::array<glm::vec3, 3>& triangle,
+  const std::array<glm::vec2, 3>& texcoord,
+  std::vector<float_t>& z_buffer,
+  TGAImage& image,
+  Texture& texture,
+  float light_intensity,
+  glm::ivec2 clamp_min,
+  glm::ivec2 clamp_max
+) {
+  Pipeline<TexturedVertexShader, TexturedFragmentShader<Texture>, FixedTriangleSetup> pipeline({}, { &texture, light_intensity });
+  pipeline.raster(triangle, TexturedFragmentShader<Texture>::from_texcoords(texcoord), z_buffer, image, clamp_min, clamp_max);
+}
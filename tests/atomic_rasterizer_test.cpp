@@ -0,0 +1,175 @@
+// AtomicFramebuffer and AtomicRasterizer: depth_key has to keep the order of depths, racing writes have to leave the
+// nearest fragment behind, resolve has to give back what was drawn, and the lessons drawn like depth_buffer_3 have to
+// match depth_buffer_2 (TileRasterizer) in color and z_buffer, on integer and on sub-pixel screen coordinates.
+// Equal depth ties are settled differently by design, see matches_tile_rasterizer.
+#define TINYOBJLOADER_IMPLEMENTATION
+
+#include "lesson_scenes.hpp"
+#include "../atomic_rasterizer.hpp"
+#include "../tgaimage.hpp"
+#include "../tile_rasterizer.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr int WIDTH = 800;
+constexpr int HEIGHT = 800;
+
+static bool depth_keys_ordered() {
+  constexpr float_t max = std::numeric_limits<float_t>::max();
+  constexpr float_t denorm = std::numeric_limits<float_t>::denorm_min();
+  const std::vector<float_t> ascending{ -max, -1e30f, -1.0f, -0.5f, -1e-30f, -denorm, 0.0f, denorm, 1e-30f, 0.5f, 1.0f, 1e30f, max };
+  bool passed = true;
+  for (size_t i = 0; i < ascending.size(); ++i) {
+    const uint32_t key = AtomicFramebuffer::depth_key(ascending[i]);
+    if (AtomicFramebuffer::key_depth(key) != ascending[i]) {
+      std::cerr << "key_depth(depth_key(" << ascending[i] << ")) is " << AtomicFramebuffer::key_depth(key) << "\n";
+      passed = false;
+    }
+    if (i && !(AtomicFramebuffer::depth_key(ascending[i - 1]) < key)) {
+      std::cerr << "depth_key(" << ascending[i - 1] << ") isn't below depth_key(" << ascending[i] << ")\n";
+      passed = false;
+    }
+  }
+  std::cout << "depth_key order: " << (passed ? "kept" : "BROKEN") << "\n";
+  return passed;
+}
+
+// Threads write random fragments to the same few pixels, each pixel has to end up with its nearest one, the larger
+// color among equally near ones. Pixels nothing was written to keep the image's color and get the cleared depth.
+static bool racing_writes_keep_nearest() {
+  constexpr int threads = 8;
+  constexpr int writes = 20000;
+  constexpr int pixels = 4;
+  AtomicFramebuffer framebuffer(pixels + 1, 1);
+
+  std::vector<std::vector<std::pair<float_t, uint32_t>>> fragments(threads);
+  for (int t = 0; t < threads; ++t) {
+    std::mt19937 rng(t);
+    for (int i = 0; i < writes; ++i)
+      // few distinct depths, so ties are common
+      fragments[t].emplace_back(float_t(int(rng() % 64) - 32) / 16, rng() | 0xFF000000u);
+  }
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      for (int i = 0; i < writes; ++i)
+        framebuffer.write(i % pixels, 0, fragments[t][i].first, TGAColor(fragments[t][i].second));
+    });
+  }
+  for (std::thread& worker : workers)
+    worker.join();
+
+  TGAImage image(pixels + 1, 1, TGAImage::RGBA);
+  const TGAColor untouched(1, 2, 3, 4);
+  image.set(pixels, 0, untouched);
+  std::vector<float_t> z_buffer(pixels + 1);
+  framebuffer.resolve(image, z_buffer);
+
+  bool passed = true;
+  for (int x = 0; x < pixels; ++x) {
+    std::pair<float_t, uint32_t> nearest{ -std::numeric_limits<float_t>::max(), 0 };
+    for (int t = 0; t < threads; ++t)
+      for (int i = x; i < writes; i += pixels)
+        nearest = std::max(nearest, fragments[t][i]);
+    if (z_buffer[x] != nearest.first || image.get(x, 0).val != nearest.second) {
+      std::cerr << "pixel " << x << " kept depth " << z_buffer[x] << " color " << std::hex << image.get(x, 0).val
+        << ", nearest was " << std::dec << nearest.first << " " << std::hex << nearest.second << std::dec << "\n";
+      passed = false;
+    }
+  }
+  if (z_buffer[pixels] != -std::numeric_limits<float_t>::max() || image.get(pixels, 0).val != untouched.val) {
+    std::cerr << "a pixel nothing was written to changed\n";
+    passed = false;
+  }
+  std::cout << "racing writes: " << (passed ? "nearest kept" : "WRONG") << "\n";
+  return passed;
+}
+
+// The fragments every triangle puts on pixel (x, y): depth and color, in submission order
+static std::vector<std::pair<float_t, uint32_t>> fragments_at(const std::vector<LessonTriangle>& triangles, TGAImage& texture, int x, int y) {
+  std::vector<std::pair<float_t, uint32_t>> fragments;
+  for (const LessonTriangle& t : triangles) {
+    const TriangleSetup setup = setup_triangle(t.screen_coords, glm::vec2(x, y), glm::vec2(x, y));
+    if (setup.area <= 1e-2)
+      continue;
+    auto& [a, b, c] = t.screen_coords;
+    walk_triangle(setup, [&](int32_t, int32_t, glm::vec3 bc) {
+      fragments.emplace_back(a.z * bc.x + b.z * bc.y + c.z * bc.z, shade_textured(texture, t.texcoords, bc, t.light_intensity).val);
+    });
+  }
+  return fragments;
+}
+
+// Both z_buffers have to be the same bytes. So do the colors, except where fragments of several triangles are nearest
+// at exactly the same depth (shared edges): TileRasterizer keeps the first of them, AtomicFramebuffer the larger color.
+static bool matches_tile_rasterizer(const std::string& name, const std::vector<LessonTriangle>& triangles, TGAImage& texture) {
+  TGAImage tiled_image(WIDTH, HEIGHT, TGAImage::RGB, TGAImage::BOTTOM_LEFT);
+  std::vector<float_t> tiled_z(WIDTH * HEIGHT, -std::numeric_limits<float_t>::max());
+  TileRasterizer tiled(WIDTH, HEIGHT);
+  for (const LessonTriangle& t : triangles)
+    tiled.submit(t.screen_coords, t.texcoords, t.light_intensity);
+  tiled.flush(tiled_z, tiled_image, texture);
+
+  TGAImage atomic_image(WIDTH, HEIGHT, TGAImage::RGB, TGAImage::BOTTOM_LEFT);
+  std::vector<float_t> atomic_z(WIDTH * HEIGHT);
+  AtomicFramebuffer framebuffer(WIDTH, HEIGHT);
+  AtomicRasterizer atomic(WIDTH, HEIGHT);
+  for (const LessonTriangle& t : triangles)
+    atomic.submit(t.screen_coords, t.texcoords, t.light_intensity);
+  atomic.flush(framebuffer, texture);
+  framebuffer.resolve(atomic_image, atomic_z);
+
+  bool passed = true;
+  if (memcmp(tiled_z.data(), atomic_z.data(), tiled_z.size() * sizeof(float_t))) {
+    std::cerr << name << ": the z_buffers differ\n";
+    passed = false;
+  }
+
+  constexpr uint32_t rgb = 0xFFFFFF;
+  int ties = 0;
+  for (int y = 0; y < HEIGHT && passed; ++y) {
+    for (int x = 0; x < WIDTH && passed; ++x) {
+      const uint32_t tiled_color = tiled_image.get(x, y).val & rgb;
+      const uint32_t atomic_color = atomic_image.get(x, y).val & rgb;
+      if (tiled_color == atomic_color)
+        continue;
+
+      const float_t nearest = tiled_z[x + y * WIDTH];
+      std::vector<uint32_t> tied;
+      for (auto [depth, color] : fragments_at(triangles, texture, x, y))
+        if (depth == nearest)
+          tied.push_back(color & rgb);
+      if (tied.size() < 2 || tied.front() != tiled_color || *std::max_element(tied.begin(), tied.end()) != atomic_color) {
+        std::cerr << name << ": pixel " << x << ", " << y << " is " << std::hex << tiled_color << " tiled and " << atomic_color
+          << " atomic" << std::dec << ", " << tied.size() << " fragments at its depth\n";
+        passed = false;
+      }
+      ++ties;
+    }
+  }
+  std::cout << name << ": " << triangles.size() << " triangles, " << (passed ? "identical" : "DIFFERENT") << " apart from "
+    << ties << " equal depth ties\n";
+  return passed;
+}
+
+int main() {
+  TGAImage texture;
+  if (!texture.read_tga_file("./assets/african_head_diffuse.tga"))
+    return EXIT_FAILURE;
+
+  bool passed = depth_keys_ordered();
+  passed = racing_writes_keep_nearest() && passed;
+  passed = matches_tile_rasterizer("depth_buffer_3 vs depth_buffer_2", head_triangles(WIDTH, HEIGHT), texture) && passed;
+  passed = matches_tile_rasterizer("perspective_projection_study_2, floating point", perspective_triangles(WIDTH, HEIGHT), texture) && passed;
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
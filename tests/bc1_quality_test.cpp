@@ -0,0 +1,73 @@
+// PSNR of the BC1 encoded african_head diffuse map against the uncompressed texels, and how fast its blocks decode.
+// Fails when the level 0 PSNR drops below MIN_PSNR, e.g. after a change to encode_bc1_block.
+#include "../benchmarks/bench.hpp"
+#include "../block_compression.hpp"
+#include "../texture.hpp"
+#include "../tgaimage.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// 41.3 dB when this was written, 40.4 dB before encode_bc1_block refit its endpoints
+constexpr double MIN_PSNR = 40.5;
+
+// Over the B, G and R channels, alpha isn't kept by BC1
+static double psnr(const Texture2D& reference, const Texture2D& compressed, int level) {
+  double squared_error = 0;
+  for (int y = 0; y < reference.get_height(level); ++y) {
+    for (int x = 0; x < reference.get_width(level); ++x) {
+      const uint32_t a = reference.fetch(level, x, y).val;
+      const uint32_t b = compressed.fetch(level, x, y).val;
+      for (int shift = 0; shift < 24; shift += 8) {
+        const double d = double((a >> shift) & 0xFF) - double((b >> shift) & 0xFF);
+        squared_error += d * d;
+      }
+    }
+  }
+  const double mean = squared_error / (3.0 * reference.get_width(level) * reference.get_height(level));
+  return mean > 0 ? 10 * std::log10(255.0 * 255.0 / mean) : INFINITY;
+}
+
+int main() {
+  TGAImage diffuse;
+  if (!diffuse.read_tga_file("./assets/african_head_diffuse.tga"))
+    return EXIT_FAILURE;
+  const Texture2D reference(diffuse, Texture2D::LINEAR);
+  const Texture2D compressed(diffuse, Texture2D::BC1);
+
+  const double level0 = psnr(reference, compressed, 0);
+  std::printf("PSNR level 0 %.2f dB, level 1 %.2f dB, level 2 %.2f dB (%zu KiB instead of %zu KiB)\n", level0,
+    psnr(reference, compressed, 1), psnr(reference, compressed, 2), compressed.size_bytes() / 1024, reference.size_bytes() / 1024);
+
+  // the level 0 blocks again, to time decode_bc1_block on its own
+  const int blocks_x = reference.get_width() / 4;
+  const int blocks_y = reference.get_height() / 4;
+  std::vector<uint64_t> blocks;
+  for (int by = 0; by < blocks_y; ++by) {
+    for (int bx = 0; bx < blocks_x; ++bx) {
+      uint32_t texels[16];
+      for (int i = 0; i < 16; ++i)
+        texels[i] = reference.fetch(0, bx * 4 + i % 4, by * 4 + i / 4).val;
+      blocks.push_back(encode_bc1_block(texels));
+    }
+  }
+  uint32_t checksum = 0;
+  const double ms = best_ms(10, [&] {
+    uint32_t texels[16];
+    for (uint64_t block : blocks) {
+      decode_bc1_block(block, texels);
+      checksum += texels[0] ^ texels[15];
+    }
+  });
+  const size_t decoded_bytes = blocks.size() * sizeof(uint32_t[16]);
+  std::printf("decode %zu blocks in %.2f ms, %.0f MB/s of BGRA8 texels (%x)\n", blocks.size(), ms, mb_per_s(decoded_bytes, ms), checksum);
+
+  if (!(level0 >= MIN_PSNR)) {
+    std::fprintf(stderr, "level 0 PSNR %.2f dB is below %.1f dB\n", level0, MIN_PSNR);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+// TileRasterizer with DEFERRED shading against FORWARD: random overlapping triangles with sub-pixel vertices have to
+// leave the same color and depth bytes behind, in both modes, with a TGAImage and a mipmapped Texture2D, and with the
+// hierarchical z testing whole tiles or every 8x8 block (forward then rasterizes a triangle in several clamp rectangles).
+#include "../texture.hpp"
+#include "../tgaimage.hpp"
+#include "../tile_rasterizer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+struct Triangle {
+  std::array<glm::vec3, 3> screen_coords;
+  std::array<glm::vec2, 3> texcoords;
+  float_t light_intensity;
+};
+
+constexpr int WIDTH = 256;
+constexpr int HEIGHT = 256;
+constexpr int TRIANGLES = 3000;
+
+static std::vector<Triangle> random_triangles() {
+  std::mt19937 rng(2024);
+  std::uniform_real_distribution<float_t> position(-8.0f, WIDTH + 8.0f);
+  std::uniform_real_distribution<float_t> offset(-24.0f, 24.0f);
+  std::uniform_real_distribution<float_t> unit(0.0f, 1.0f);
+  std::vector<Triangle> triangles(TRIANGLES);
+  for (Triangle& t : triangles) {
+    const glm::vec2 center{ position(rng), position(rng) };
+    for (int i = 0; i < 3; ++i) {
+      t.screen_coords[i] = glm::vec3(center.x + offset(rng), center.y + offset(rng), unit(rng) * 2 - 1);
+      t.texcoords[i] = glm::vec2(unit(rng), unit(rng));
+    }
+    t.light_intensity = unit(rng);
+  }
+  return triangles;
+}
+
+template<class Texture>
+static void render(const std::vector<Triangle>& triangles, TileRasterizer::Mode mode, TileRasterizer::Shading shading, int hiz_min_blocks,
+  Texture& texture, TGAImage& image, std::vector<float_t>& z_buffer) {
+  image = TGAImage(WIDTH, HEIGHT, TGAImage::RGB, TGAImage::BOTTOM_LEFT);
+  z_buffer.assign(WIDTH * HEIGHT, -std::numeric_limits<float_t>::max());
+  TileRasterizer rasterizer(WIDTH, HEIGHT, mode, shading, 64, hiz_min_blocks);
+  for (const Triangle& t : triangles)
+    rasterizer.submit(t.screen_coords, t.texcoords, t.light_intensity);
+  rasterizer.flush(z_buffer, image, texture);
+}
+
+// Prints the number of differing bytes and the first of them, if any
+static bool same_bytes(const std::string& what, const unsigned char* expected, const unsigned char* actual, size_t size) {
+  size_t differing = 0;
+  for (size_t i = 0; i < size; ++i) {
+    if (expected[i] != actual[i] && !differing++)
+      std::cerr << what << " differs at byte " << i << ": forward " << int(expected[i]) << ", deferred " << int(actual[i]) << "\n";
+  }
+  if (differing)
+    std::cerr << what << ": " << differing << " bytes differ\n";
+  return !differing;
+}
+
+template<class Texture>
+static bool compare(const std::string& name, const std::vector<Triangle>& triangles, Texture& texture) {
+  bool passed = true;
+  for (TileRasterizer::Mode mode : { TileRasterizer::FLOATING_POINT, TileRasterizer::FIXED_POINT }) {
+    for (int hiz_min_blocks : { 0, TileRasterizer::HIZ_MIN_BLOCKS }) {
+      TGAImage forward_image, deferred_image;
+      std::vector<float_t> forward_z, deferred_z;
+      render(triangles, mode, TileRasterizer::FORWARD, hiz_min_blocks, texture, forward_image, forward_z);
+      render(triangles, mode, TileRasterizer::DEFERRED, hiz_min_blocks, texture, deferred_image, deferred_z);
+
+      const std::string what = name + (mode == TileRasterizer::FIXED_POINT ? ", fixed point" : ", floating point")
+        + ", hiz_min_blocks " + std::to_string(hiz_min_blocks);
+      const bool same = same_bytes(what + " image", forward_image.buffer(), deferred_image.buffer(), size_t(WIDTH) * HEIGHT * TGAImage::RGB)
+        && same_bytes(what + " z_buffer", reinterpret_cast<const unsigned char*>(forward_z.data()),
+          reinterpret_cast<const unsigned char*>(deferred_z.data()), forward_z.size() * sizeof(float_t));
+      std::cout << what << ": " << (same ? "identical" : "DIFFERENT") << "\n";
+      passed = passed && same;
+    }
+  }
+  return passed;
+}
+
+int main() {
+  TGAImage texture;
+  if (!texture.read_tga_file("./assets/african_head_diffuse.tga"))
+    return EXIT_FAILURE;
+  Texture2D mipmapped(texture);
+
+  const std::vector<Triangle> triangles = random_triangles();
+  bool passed = compare("TGAImage", triangles, texture);
+  passed = compare("Texture2D", triangles, mipmapped) && passed;
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,138 @@
+// Watertightness of the fixed point setup (setup_triangle_fixed and its walk_triangle): meshes of triangles sharing
+// edges and vertices at random sub-pixel positions, jittered grids and fans around a common center, tile a
+// rectangle whose border lies between pixel centers. Every pixel in it has to be hit exactly once, none outside,
+// whatever the winding of each triangle.
+#include "../rasterization.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+constexpr int WIDTH = 48;
+constexpr int HEIGHT = 40;
+// room around the rectangle, hits there are counted too
+constexpr int MARGIN = 4;
+
+using Mesh = std::vector<std::array<glm::vec2, 3>>;
+
+static glm::vec2 pixel_corner(float_t x, float_t y) {
+  return { x - 0.5f, y - 0.5f };
+}
+
+// Shuffles each triangle's vertices, so both windings and every starting vertex come up
+static void shuffle_windings(Mesh& mesh, std::mt19937& mt) {
+  for (auto& triangle : mesh)
+    std::shuffle(triangle.begin(), triangle.end(), mt);
+}
+
+static float_t signed_area(const std::array<glm::vec2, 3>& t) {
+  return (t[1].x - t[0].x) * (t[2].y - t[0].y) - (t[2].x - t[0].x) * (t[1].y - t[0].y);
+}
+
+// Quads of a grid whose inner vertices are moved up to 0.3 cells off, split along alternating diagonals. A quad
+// bent too far would fold over its diagonal, such grids are drawn again.
+static Mesh jittered_grid(std::mt19937& mt, int columns, int rows) {
+  std::uniform_real_distribution<float_t> jitter(-0.3f, 0.3f);
+  const float_t cell_x = float_t(WIDTH) / columns, cell_y = float_t(HEIGHT) / rows;
+  std::vector<glm::vec2> vertices;
+  for (int j = 0; j <= rows; ++j) {
+    for (int i = 0; i <= columns; ++i) {
+      // the border only moves along itself
+      const float_t dx = i == 0 || i == columns ? 0 : jitter(mt) * cell_x;
+      const float_t dy = j == 0 || j == rows ? 0 : jitter(mt) * cell_y;
+      glm::vec2 vertex = pixel_corner(i * cell_x + dx, j * cell_y + dy);
+      // some inner vertices right on a pixel sample, the edges through them pass samples too
+      if (dx && dy && (i + 2 * j) % 3 == 0)
+        vertex = glm::round(vertex);
+      vertices.push_back(vertex);
+    }
+  }
+
+  Mesh mesh;
+  for (int j = 0; j < rows; ++j) {
+    for (int i = 0; i < columns; ++i) {
+      const glm::vec2 a = vertices[j * (columns + 1) + i], b = vertices[j * (columns + 1) + i + 1];
+      const glm::vec2 c = vertices[(j + 1) * (columns + 1) + i], d = vertices[(j + 1) * (columns + 1) + i + 1];
+      if ((i + j) % 2) {
+        mesh.push_back({ a, b, d });
+        mesh.push_back({ a, d, c });
+      } else {
+        mesh.push_back({ a, b, c });
+        mesh.push_back({ b, d, c });
+      }
+    }
+  }
+  for (const auto& triangle : mesh)
+    if (signed_area(triangle) <= 0)
+      return jittered_grid(mt, columns, rows);
+  shuffle_windings(mesh, mt);
+  return mesh;
+}
+
+// Triangles from `center` to consecutive points along the border, `center` on a pixel sample when `on_sample`
+static Mesh fan(std::mt19937& mt, int points_per_side, bool on_sample) {
+  std::uniform_real_distribution<float_t> along(0, 1);
+  std::uniform_real_distribution<float_t> inside(0.2f, 0.8f);
+  glm::vec2 center{ inside(mt) * WIDTH, inside(mt) * HEIGHT };
+  if (on_sample)
+    center = glm::round(center);
+
+  const glm::vec2 corners[4] = { pixel_corner(0, 0), pixel_corner(WIDTH, 0), pixel_corner(WIDTH, HEIGHT), pixel_corner(0, HEIGHT) };
+  std::vector<glm::vec2> border;
+  for (int side = 0; side < 4; ++side) {
+    std::vector<float_t> ts(points_per_side);
+    for (float_t& t : ts)
+      t = along(mt);
+    std::sort(ts.begin(), ts.end());
+    border.push_back(corners[side]);
+    for (float_t t : ts)
+      border.push_back(corners[side] + t * (corners[(side + 1) % 4] - corners[side]));
+  }
+
+  Mesh mesh;
+  for (size_t i = 0; i < border.size(); ++i)
+    mesh.push_back({ center, border[i], border[(i + 1) % border.size()] });
+  shuffle_windings(mesh, mt);
+  return mesh;
+}
+
+static bool covered_once(const Mesh& mesh, const char* name) {
+  const int stride = WIDTH + 2 * MARGIN;
+  std::vector<int> hits(size_t(stride) * (HEIGHT + 2 * MARGIN));
+  for (const auto& triangle : mesh) {
+    const FixedTriangleSetup setup = setup_triangle_fixed(triangle, { -MARGIN, -MARGIN }, { WIDTH + MARGIN - 1, HEIGHT + MARGIN - 1 });
+    // degenerate triangles are skipped like Pipeline does
+    if (setup.area == 0)
+      continue;
+    walk_triangle(setup, [&](int32_t x, int32_t y, glm::vec3) {
+      ++hits[(y + MARGIN) * stride + x + MARGIN];
+    });
+  }
+
+  int wrong = 0;
+  for (int y = -MARGIN; y < HEIGHT + MARGIN; ++y) {
+    for (int x = -MARGIN; x < WIDTH + MARGIN; ++x) {
+      const int expected = x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT ? 1 : 0;
+      const int count = hits[(y + MARGIN) * stride + x + MARGIN];
+      if (count != expected && !wrong++)
+        std::cerr << name << ": pixel " << x << "," << y << " hit " << count << " times\n";
+    }
+  }
+  if (wrong)
+    std::cerr << name << ": " << wrong << " pixels not hit exactly once\n";
+  return !wrong;
+}
+
+int main() {
+  std::mt19937 mt(4);
+  bool passed = true;
+  int meshes = 0;
+  for (int i = 0; i < 40; ++i) {
+    passed = covered_once(jittered_grid(mt, 4 + i % 13, 3 + i % 11), "grid") && passed;
+    passed = covered_once(fan(mt, 1 + i % 7, i % 2), "fan") && passed;
+    meshes += 2;
+  }
+  std::cout << meshes << " meshes of " << WIDTH << "x" << HEIGHT << (passed ? ": every pixel hit once" : ": FAILED") << "\n";
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
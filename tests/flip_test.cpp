@@ -0,0 +1,46 @@
+// TGAImage::flip_horizontally (reverse_row, 16 or 48 bytes at a time in SSE registers) against swapping pixel by
+// pixel: every pixel size and widths around the block sizes, so that the blocks and the tail both get used.
+// Built a second time with -mssse3 (see tests/CMakeLists.txt), that build exits with 77 (skipped) without SSSE3.
+#include "../tgaimage.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+static bool flips_like_reference(int width, int height, int bytespp) {
+  TGAImage image(width, height, bytespp);
+  const size_t row_size = size_t(width) * bytespp;
+  unsigned seed = 1 + width * 131 + bytespp;
+  for (size_t i = 0; i < row_size * height; ++i) {
+    seed = seed * 1103515245 + 12345;
+    image.buffer()[i] = seed >> 16;
+  }
+
+  std::vector<unsigned char> expected(image.buffer(), image.buffer() + row_size * height);
+  for (int y = 0; y < height; ++y)
+    for (int x = 0; x < width; ++x)
+      memcpy(&expected[y * row_size + x * bytespp], image.buffer() + y * row_size + (width - 1 - x) * bytespp, bytespp);
+
+  image.flip_horizontally();
+  if (memcmp(image.buffer(), expected.data(), expected.size())) {
+    std::cerr << width << "x" << height << "/" << bytespp * 8 << " flipped differently\n";
+    return false;
+  }
+  return true;
+}
+
+int main() {
+#if defined(__SSSE3__)
+  if (!__builtin_cpu_supports("ssse3")) {
+    std::cout << "no SSSE3 on this CPU, skipped\n";
+    return 77;
+  }
+#endif
+  bool passed = true;
+  for (int bytespp : { TGAImage::GRAYSCALE, TGAImage::RGB, TGAImage::RGBA })
+    for (int width = 1; width <= 200; ++width)
+      passed = flips_like_reference(width, 3, bytespp) && passed;
+  std::cout << (passed ? "all widths flipped like the reference\n" : "FAILED\n");
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
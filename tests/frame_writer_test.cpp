@@ -0,0 +1,56 @@
+// FrameWriter writes what it's given, and rejects images it didn't hand out and any use after finish()
+#include "../frame_writer.hpp"
+#include "../tgaimage.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+template<class Fn>
+static bool throws_logic_error(Fn&& fn) {
+  try {
+    fn();
+  } catch (const std::logic_error&) {
+    return true;
+  }
+  return false;
+}
+
+static bool check(bool condition, const char* what) {
+  if (!condition)
+    std::cerr << "failed: " << what << "\n";
+  return condition;
+}
+
+int main() {
+  const std::filesystem::path directory = std::filesystem::temp_directory_path();
+  bool passed = true;
+  {
+    FrameWriter writer(16, 8, TGAImage::RGB);
+    std::string filenames[3];
+    for (int i = 0; i < 3; ++i) {
+      filenames[i] = (directory / ("frame_writer_test_" + std::to_string(i) + ".tga")).string();
+      TGAImage& frame = writer.acquire();
+      frame.set(i, 0, TGAColor(255, 255, 255, 255));
+      writer.submit(frame, filenames[i]);
+      passed = check(throws_logic_error([&] { writer.submit(frame, filenames[i]); }), "submitting a frame twice throws") && passed;
+    }
+
+    TGAImage foreign(16, 8, TGAImage::RGB);
+    passed = check(throws_logic_error([&] { writer.submit(foreign, "foreign.tga"); }), "submitting a foreign image throws") && passed;
+
+    TGAImage& unsubmitted = writer.acquire();
+    passed = check(writer.finish(), "every frame is written") && passed;
+    passed = check(throws_logic_error([&] { writer.acquire(); }), "acquire() after finish() throws") && passed;
+    passed = check(throws_logic_error([&] { writer.submit(unsubmitted, "late.tga"); }), "submit() after finish() throws") && passed;
+
+    for (int i = 0; i < 3; ++i) {
+      TGAImage image;
+      passed = check(image.read_tga_file(filenames[i].c_str()) && image.get(i, 0).val != 0, "written frames read back") && passed;
+      std::filesystem::remove(filenames[i]);
+    }
+  }
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,86 @@
+// Screen space triangles of the textured lessons, for the tests that draw them through two rasterizers and compare.
+// The including test defines TINYOBJLOADER_IMPLEMENTATION.
+#pragma once
+
+#include "../clipping.hpp"
+#include "../obj_loader_helper.hpp"
+#include "../rasterization.hpp"
+#include "../vertex_processing.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <array>
+#include <limits>
+#include <vector>
+
+struct LessonTriangle {
+  std::array<glm::vec3, 3> screen_coords;
+  std::array<glm::vec2, 3> texcoords;
+  float_t light_intensity;
+};
+
+// depth_buffer_2, depth_buffer_3 and textured_shading all light the faces this way, on integer screen coordinates
+inline std::vector<LessonTriangle> head_triangles(int width, int height) {
+  constexpr glm::vec3 light_dir{ 0.3, 0, -1 };
+  constexpr float_t ambient_light_contribution = 0.4;
+  std::vector<LessonTriangle> triangles;
+  load_model_and_for_each_face("./assets/african_head.obj", [&](auto face_vertices, auto, auto face_texcoords) -> void {
+    auto& [a, b, c] = face_vertices;
+    const glm::vec3 face_normal = glm::normalize(glm::cross(c - a, b - a));
+    const float_t light_intensity = glm::clamp(glm::dot(face_normal, light_dir) + ambient_light_contribution, 0.f, 1.f);
+    if (light_intensity <= 0)
+      return;
+
+    LessonTriangle t{ {}, face_texcoords, light_intensity };
+    for (int i = 0; i < 3; ++i)
+      t.screen_coords[i] = world_to_screen(face_vertices[i], width, height);
+    triangles.push_back(t);
+  });
+  return triangles;
+}
+
+// perspective_projection_study_2 without its meshlet culling: sub-pixel screen coordinates and clipped polygons
+inline std::vector<LessonTriangle> perspective_triangles(int width, int height) {
+  constexpr glm::vec3 light_dir{ 0.0f, 0.0f, -1.0f };
+  constexpr float_t ambient_light_contribution = 0.4;
+  constexpr float_t z_near = 0.5f;
+  constexpr float_t z_far = 10000.0f;
+  const float_t fv = 1.0f / glm::tan(180.0f / 2.0f);
+  const float_t ar = float_t(height) / float_t(width);
+
+  glm::mat4 projection(0.0f);
+  projection[0][0] = ar * fv;
+  projection[1][1] = fv;
+  projection[2][2] = z_far / (z_far - z_near);
+  projection[3][2] = (-z_far * z_near) / (z_far - z_near);
+  projection[2][3] = 1.0f;
+  const glm::mat4 mvp = projection * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 2.0f));
+  const Viewport viewport = make_viewport(width, height);
+
+  std::vector<LessonTriangle> triangles;
+  load_model_and_for_each_face("./assets/african_head.obj", [&](auto face_vertices, auto, auto face_texcoords) -> void {
+    auto& [a, b, c] = face_vertices;
+    const glm::vec3 face_normal = glm::normalize(glm::cross(c - a, b - a));
+    const float_t light_intensity = glm::clamp((glm::dot(face_normal, light_dir) + 0.1f / 2.0f) + ambient_light_contribution, 0.0f, 1.0f);
+    if (light_intensity <= std::numeric_limits<float_t>::epsilon())
+      return;
+
+    std::array<ClipVertex, 3> clip_coords;
+    for (int i = 0; i < 3; ++i)
+      clip_coords[i] = ClipVertex{ mvp * glm::vec4(face_vertices[i], 1.0f), face_texcoords[i] };
+    const ClipPolygon polygon = clip_triangle(clip_coords);
+
+    for (size_t i = 2; i < polygon.size; ++i) {
+      const ClipVertex& p0 = polygon.vertices[0];
+      const ClipVertex& p1 = polygon.vertices[i - 1];
+      const ClipVertex& p2 = polygon.vertices[i];
+      triangles.push_back(LessonTriangle{
+        { clip_to_screen(p0.position, viewport), clip_to_screen(p1.position, viewport), clip_to_screen(p2.position, viewport) },
+        { p0.texcoord, p1.texcoord, p2.texcoord },
+        light_intensity
+      });
+    }
+  });
+  return triangles;
+}
@@ -0,0 +1,98 @@
+// Draws the triangles of the textured lessons with raster_triangle_with_depth_buffer_avx2 and with
+// raster_triangle_with_depth_buffer_scalar, the two have to leave the same color and depth bytes behind.
+// Built with -mavx2 (see tests/CMakeLists.txt), exits with 77 (skipped) on a CPU without AVX2.
+#define TINYOBJLOADER_IMPLEMENTATION
+
+#include "lesson_scenes.hpp"
+#include "../rasterization.hpp"
+#include "../shaders.hpp"
+#include "../tgaimage.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#if !defined(__AVX2__)
+#error "rasterization_avx2_test has to be compiled with AVX2 enabled"
+#endif
+
+struct Scene {
+  std::string name;
+  std::vector<LessonTriangle> triangles;
+  // side of the screen tiles the triangles are clamped to, 0 for the whole screen
+  int tile_size;
+  TGAImage::Origin texture_origin;
+};
+
+constexpr int WIDTH = 800;
+constexpr int HEIGHT = 800;
+
+template<class Raster>
+static void render(const Scene& scene, TGAImage& texture, TGAImage& image, std::vector<float_t>& z_buffer, Raster raster) {
+  image = TGAImage(WIDTH, HEIGHT, TGAImage::RGB, TGAImage::BOTTOM_LEFT);
+  z_buffer.assign(WIDTH * HEIGHT, -std::numeric_limits<float_t>::max());
+  const int tile_size = scene.tile_size ? scene.tile_size : std::max(WIDTH, HEIGHT);
+  for (int tile_y = 0; tile_y < HEIGHT; tile_y += tile_size) {
+    for (int tile_x = 0; tile_x < WIDTH; tile_x += tile_size) {
+      const glm::vec2 clamp_min{ tile_x, tile_y };
+      const glm::vec2 clamp_max{ std::min(tile_x + tile_size, WIDTH) - 1, std::min(tile_y + tile_size, HEIGHT) - 1 };
+      for (LessonTriangle t : scene.triangles)
+        raster(t.screen_coords, t.texcoords, z_buffer, image, texture, t.light_intensity, clamp_min, clamp_max);
+    }
+  }
+}
+
+// Prints the first differing byte, if any
+static bool same_bytes(const std::string& what, const unsigned char* expected, const unsigned char* actual, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    if (expected[i] != actual[i]) {
+      std::cerr << what << " differs at byte " << i << ": scalar " << int(expected[i]) << ", avx2 " << int(actual[i]) << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  if (!__builtin_cpu_supports("avx2")) {
+    std::cout << "no AVX2 on this CPU, skipped\n";
+    return 77;
+  }
+
+  TGAImage texture;
+  if (!texture.read_tga_file("./assets/african_head_diffuse.tga"))
+    return EXIT_FAILURE;
+  // the same picture stored top row first, for the row flip of the gathers
+  TGAImage texture_top_left(texture);
+  texture_top_left.flip_vertically();
+  texture_top_left.set_origin(TGAImage::TOP_LEFT);
+
+  const std::vector<LessonTriangle> head = head_triangles(WIDTH, HEIGHT);
+  const std::vector<Scene> scenes{
+    { "depth_buffer_2", head, 64, texture.get_origin() },
+    { "depth_buffer_3", head, 0, texture.get_origin() },
+    { "textured_shading", head, 0, TGAImage::TOP_LEFT },
+    { "perspective_projection_study_2", perspective_triangles(WIDTH, HEIGHT), 64, texture.get_origin() },
+  };
+
+  bool passed = true;
+  for (const Scene& scene : scenes) {
+    TGAImage& scene_texture = scene.texture_origin == TGAImage::TOP_LEFT ? texture_top_left : texture;
+    TGAImage scalar_image, avx2_image;
+    std::vector<float_t> scalar_z, avx2_z;
+    render(scene, scene_texture, scalar_image, scalar_z, raster_triangle_with_depth_buffer_scalar<TGAImage>);
+    render(scene, scene_texture, avx2_image, avx2_z, raster_triangle_with_depth_buffer_avx2);
+
+    const size_t image_size = size_t(WIDTH) * HEIGHT * TGAImage::RGB;
+    const bool same = same_bytes(scene.name + " image", scalar_image.buffer(), avx2_image.buffer(), image_size)
+      && same_bytes(scene.name + " z_buffer", reinterpret_cast<const unsigned char*>(scalar_z.data()), reinterpret_cast<const unsigned char*>(avx2_z.data()), scalar_z.size() * sizeof(float_t));
+    std::cout << scene.name << ": " << scene.triangles.size() << " triangles, " << (same ? "identical" : "DIFFERENT") << "\n";
+    passed = passed && same;
+  }
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,109 @@
+// Resampler against results known exactly: BOX halving every pixel size is the rounded average of each 2x2 block,
+// LANCZOS to the same size gives the image back, and opaque red next to fully transparent green stays pure red
+// (premultiplied alpha) with every filter, shrinking and enlarging. A source of the wrong size is refused.
+#include "../resample.hpp"
+#include "../tgaimage.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Pseudo random bytes, alpha at least `min_alpha` for RGBA
+static TGAImage noise(int width, int height, int bytespp, unsigned min_alpha) {
+  TGAImage image(width, height, bytespp);
+  unsigned seed = 1 + width * 131 + bytespp;
+  for (size_t i = 0; i < size_t(width) * height * bytespp; ++i) {
+    seed = seed * 1103515245 + 12345;
+    unsigned char value = seed >> 16;
+    if (bytespp == TGAImage::RGBA && i % 4 == 3)
+      value = min_alpha + value % (256 - min_alpha);
+    image.buffer()[i] = value;
+  }
+  return image;
+}
+
+static bool box_halves_to_average(int bytespp) {
+  const int width = 62, height = 38;
+  // opaque, so that premultiplying leaves the colors as they are
+  TGAImage src = noise(width, height, bytespp, 255);
+  TGAImage dst;
+  Resampler(width, height, width / 2, height / 2, Resampler::BOX).resample(src, dst);
+
+  const unsigned char* in = src.buffer();
+  for (int y = 0; y < height / 2; ++y) {
+    for (int x = 0; x < width / 2; ++x) {
+      for (int c = 0; c < bytespp; ++c) {
+        const int sum = in[((2 * y) * width + 2 * x) * bytespp + c] + in[((2 * y) * width + 2 * x + 1) * bytespp + c]
+          + in[((2 * y + 1) * width + 2 * x) * bytespp + c] + in[((2 * y + 1) * width + 2 * x + 1) * bytespp + c];
+        const long expected = std::lrint(sum / 4.0f);
+        const int actual = dst.buffer()[(y * (width / 2) + x) * bytespp + c];
+        if (actual != expected) {
+          std::cerr << bytespp * 8 << " bpp BOX 2x at " << x << "," << y << " channel " << c << ": " << actual << ", average " << expected << "\n";
+          return false;
+        }
+      }
+    }
+  }
+  std::cout << bytespp * 8 << " bpp BOX 2x: 2x2 averages\n";
+  return true;
+}
+
+static bool lanczos_same_size_is_identity(int bytespp) {
+  const int width = 45, height = 29;
+  // a fully transparent pixel would come back black
+  TGAImage src = noise(width, height, bytespp, 1);
+  TGAImage dst;
+  Resampler(width, height, width, height, Resampler::LANCZOS).resample(src, dst);
+  const bool same = !memcmp(src.buffer(), dst.buffer(), size_t(width) * height * bytespp);
+  std::cout << bytespp * 8 << " bpp LANCZOS same size: " << (same ? "identity" : "CHANGED") << "\n";
+  return same;
+}
+
+static const char* filter_name(Resampler::Filter filter) {
+  return filter == Resampler::BOX ? "BOX" : filter == Resampler::BILINEAR ? "BILINEAR" : "LANCZOS";
+}
+
+static bool transparent_does_not_bleed(Resampler::Filter filter, int dst_width, int dst_height) {
+  const int width = 40, height = 24;
+  TGAImage src(width, height, TGAImage::RGBA);
+  for (int y = 0; y < height; ++y)
+    for (int x = 0; x < width; ++x)
+      src.set(x, y, (x / 3 + y / 2) % 2 ? TGAColor(255, 0, 0, 255) : TGAColor(0, 255, 0, 0));
+
+  TGAImage dst;
+  Resampler(width, height, dst_width, dst_height, filter).resample(src, dst);
+  for (int y = 0; y < dst_height; ++y) {
+    for (int x = 0; x < dst_width; ++x) {
+      const TGAColor color = dst.get(x, y);
+      // where the alpha is tiny its rounding shows in the red
+      if (color.g || color.b || (color.a >= 16 && color.r < 250)) {
+        std::cerr << filter_name(filter) << " to " << dst_width << "x" << dst_height << " at " << x << "," << y << ": rgba "
+          << int(color.r) << " " << int(color.g) << " " << int(color.b) << " " << int(color.a) << "\n";
+        return false;
+      }
+    }
+  }
+  std::cout << filter_name(filter) << " to " << dst_width << "x" << dst_height << ": no green\n";
+  return true;
+}
+
+int main() {
+  bool passed = true;
+  for (int bytespp : { TGAImage::GRAYSCALE, TGAImage::RGB, TGAImage::RGBA }) {
+    passed = box_halves_to_average(bytespp) && passed;
+    passed = lanczos_same_size_is_identity(bytespp) && passed;
+  }
+  for (Resampler::Filter filter : { Resampler::BOX, Resampler::BILINEAR, Resampler::LANCZOS }) {
+    passed = transparent_does_not_bleed(filter, 13, 7) && passed;
+    passed = transparent_does_not_bleed(filter, 97, 61) && passed;
+  }
+
+  TGAImage wrong = noise(10, 10, TGAImage::RGB, 0);
+  TGAImage dst;
+  if (Resampler(20, 10, 5, 5).resample(wrong, dst) || dst.buffer()) {
+    std::cerr << "a 10x10 source was resampled as 20x10\n";
+    passed = false;
+  }
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,98 @@
+// The scanline RLE encoders of tgaimage.cpp against a brute force search: on short random rows of long and short
+// runs at 1, 3 and 4 bytes per pixel, encode_rle_row_optimal (and encode_rle_row, greedy above one byte per pixel)
+// have to produce as few bytes as the best of all packet sequences, and packets that decode back to the row.
+// The encoders live in an anonymous namespace, so tgaimage.cpp is compiled into this file instead of linked.
+#include "../tgaimage.cpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Fewest bytes for the row, trying every raw and run packet at every position
+static long brute_force_size(const std::vector<unsigned char>& row, int width, int bytespp) {
+  std::vector<long> best(width + 1, 0);
+  for (int x = width - 1; x >= 0; --x) {
+    best[x] = -1;
+    bool repeats = true;
+    for (int length = 1; length <= 128 && x + length <= width; ++length) {
+      if (length > 1)
+        repeats = repeats && !memcmp(&row[(x + length - 1) * bytespp], &row[x * bytespp], bytespp);
+      long size = 1 + long(length) * bytespp + best[x + length];
+      if (repeats)
+        size = std::min(size, 1 + long(bytespp) + best[x + length]);
+      if (best[x] < 0 || size < best[x])
+        best[x] = size;
+    }
+  }
+  return best[0];
+}
+
+// Unpacks `size` bytes of packets, false if they don't make exactly `row`
+static bool decodes_to(const unsigned char* packets, size_t size, const std::vector<unsigned char>& row, int bytespp) {
+  std::vector<unsigned char> decoded;
+  for (size_t i = 0; i < size;) {
+    const unsigned char header = packets[i++];
+    const int length = (header & 127) + 1;
+    for (int k = 0; k < length; ++k) {
+      if (i + bytespp > size)
+        return false;
+      decoded.insert(decoded.end(), packets + i, packets + i + bytespp);
+      if (header < 128 || k == length - 1)
+        i += bytespp;
+    }
+  }
+  return decoded == row;
+}
+
+// Runs of 1 to 3 pixels mixed with runs around one and two 128 pixel packets, from a few colors so that
+// neighbouring runs sometimes merge
+static std::vector<unsigned char> random_row(std::mt19937& mt, int width, int bytespp) {
+  std::uniform_int_distribution<int> kind(0, 9);
+  std::uniform_int_distribution<int> short_run(1, 3);
+  std::uniform_int_distribution<int> long_run(-3, 3);
+  std::uniform_int_distribution<int> color(0, 3);
+  std::vector<unsigned char> row;
+  while (int(row.size()) < width * bytespp) {
+    const int k = kind(mt);
+    const int length = k < 7 ? short_run(mt) : (k < 9 ? 128 : 256) + long_run(mt);
+    const unsigned char value = color(mt) * 60;
+    for (int i = 0; i < length * bytespp; ++i)
+      row.push_back(value + i % bytespp);
+  }
+  row.resize(width * bytespp);
+  return row;
+}
+
+int main() {
+  std::mt19937 mt(20);
+  std::uniform_int_distribution<int> widths(1, 400);
+  bool passed = true;
+  for (int bytespp : { 1, 3, 4 }) {
+    int optimal_failures = 0, written_failures = 0;
+    for (int i = 0; i < 2000; ++i) {
+      const int width = widths(mt);
+      const std::vector<unsigned char> row = random_row(mt, width, bytespp);
+      const long best = brute_force_size(row, width, bytespp);
+
+      RLEScratch scratch(width);
+      find_repeats(row.data(), width, bytespp, scratch.equal.data());
+      std::vector<unsigned char> optimal(width * bytespp + (width + 127) / 128);
+      const size_t optimal_size = encode_rle_row_optimal(row.data(), width, bytespp, scratch, optimal.data()) - optimal.data();
+      if (long(optimal_size) != best || !decodes_to(optimal.data(), optimal_size, row, bytespp)) {
+        if (!optimal_failures++)
+          std::cerr << width << "/" << bytespp * 8 << ": encode_rle_row_optimal " << optimal_size << " bytes, brute force " << best << "\n";
+      }
+
+      std::vector<unsigned char> written;
+      encode_rle_row(row.data(), width, bytespp, scratch, written);
+      if (long(written.size()) != best || !decodes_to(written.data(), written.size(), row, bytespp)) {
+        if (!written_failures++)
+          std::cerr << width << "/" << bytespp * 8 << ": encode_rle_row " << written.size() << " bytes, brute force " << best << "\n";
+      }
+    }
+    std::cout << bytespp * 8 << " bpp: " << optimal_failures << " optimal, " << written_failures << " written rows off the minimum\n";
+    passed = passed && !optimal_failures && !written_failures;
+  }
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
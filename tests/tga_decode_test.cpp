@@ -0,0 +1,108 @@
+// TGAImage::read_tga_file (mapped file, load_rle_data) against the old stream decoder in tga_reference.hpp: every
+// TGA shipped in ./assets, and those files written back raw and RLE in all three pixel sizes, odd sizes and both
+// origins, have to decode to the same pixels. An image of several RLE bands written serially and in parallel has to
+// come out byte for byte the same file.
+#include "tga_reference.hpp"
+#include "../tgaimage.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static bool decode_both(const std::string& filename) {
+  TGAImage image;
+  ReferenceTGA reference;
+  const bool mapped = image.read_tga_file(filename.c_str());
+  const bool streamed = read_reference_tga(filename.c_str(), reference);
+  if (!mapped || !streamed) {
+    std::cerr << filename << ": read_tga_file " << mapped << ", reference decoder " << streamed << "\n";
+    return false;
+  }
+  const bool same = image.get_width() == reference.width && image.get_height() == reference.height
+    && image.get_bytespp() == reference.bytespp && (image.get_origin() == TGAImage::TOP_LEFT) == reference.top_left
+    && !memcmp(image.buffer(), reference.data.data(), reference.data.size());
+  std::cout << filename << ": " << reference.width << "x" << reference.height << "/" << reference.bytespp * 8 << (same ? " same" : " DIFFERENT") << "\n";
+  return same;
+}
+
+// `source` converted to `bytespp`, with an alpha pattern for RGBA
+static TGAImage convert(TGAImage& source, int bytespp, TGAImage::Origin origin) {
+  TGAImage image(source.get_width(), source.get_height(), bytespp, origin);
+  for (int y = 0; y < image.get_height(); ++y) {
+    for (int x = 0; x < image.get_width(); ++x) {
+      TGAColor color = source.get(x, y);
+      color.a = (x ^ y) & 0xFF;
+      image.set(x, y, color);
+    }
+  }
+  return image;
+}
+
+static std::vector<char> file_bytes(const std::string& filename) {
+  std::ifstream in(filename, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// `image` is written RLE with and without `parallel`, the files have to be identical and decode to `image`
+static bool write_both(TGAImage& image, const std::filesystem::path& directory) {
+  const std::string name = "tga_decode_test_" + std::to_string(image.get_width()) + "_" + std::to_string(image.get_bytespp());
+  const std::string serial = (directory / (name + "_serial.tga")).string();
+  const std::string parallel = (directory / (name + "_parallel.tga")).string();
+  bool same = image.write_tga_file(serial.c_str(), true, false) && image.write_tga_file(parallel.c_str(), true, true);
+  same = same && file_bytes(serial) == file_bytes(parallel);
+  std::cout << name << ": serial and parallel " << (same ? "same" : "DIFFERENT") << "\n";
+  same = same && decode_both(parallel);
+  std::filesystem::remove(serial);
+  std::filesystem::remove(parallel);
+  return same;
+}
+
+int main() {
+  std::vector<std::string> shipped;
+  for (const auto& entry : std::filesystem::directory_iterator("./assets"))
+    if (entry.path().extension() == ".tga")
+      shipped.push_back(entry.path().string());
+  if (shipped.empty()) {
+    std::cerr << "no TGA files in ./assets\n";
+    return EXIT_FAILURE;
+  }
+
+  bool passed = true;
+  const std::filesystem::path directory = std::filesystem::temp_directory_path();
+  for (const std::string& filename : shipped) {
+    passed = decode_both(filename) && passed;
+
+    TGAImage source;
+    source.read_tga_file(filename.c_str());
+    TGAImage odd(source);
+    odd.scale(333, 217);
+    for (TGAImage* image : { &source, &odd }) {
+      for (int bytespp : { TGAImage::GRAYSCALE, TGAImage::RGB, TGAImage::RGBA }) {
+        for (TGAImage::Origin origin : { TGAImage::BOTTOM_LEFT, TGAImage::TOP_LEFT }) {
+          TGAImage variant = convert(*image, bytespp, origin);
+          for (bool rle : { false, true }) {
+            const std::string written = (directory / ("tga_decode_test_" + std::to_string(variant.get_width()) + "_" + std::to_string(bytespp)
+              + (origin == TGAImage::TOP_LEFT ? "_top" : "_bottom") + (rle ? "_rle.tga" : "_raw.tga"))).string();
+            passed = variant.write_tga_file(written.c_str(), rle) && decode_both(written) && passed;
+            std::filesystem::remove(written);
+          }
+        }
+      }
+    }
+  }
+
+  // several times the 1 MiB band of TGAImage::unload_rle_data at every pixel size, with a last band that is cut short
+  TGAImage large;
+  large.read_tga_file(shipped.front().c_str());
+  large.scale(1999, 1501);
+  for (int bytespp : { TGAImage::GRAYSCALE, TGAImage::RGB, TGAImage::RGBA }) {
+    TGAImage variant = convert(large, bytespp, TGAImage::BOTTOM_LEFT);
+    passed = write_both(variant, directory) && passed;
+  }
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
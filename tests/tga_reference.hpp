@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+// The TGA decoder as it was before read_tga_file mapped its file: std::ifstream, one chunk header and one pixel
+// at a time. The reference TGAImage's reader is compared (tests/tga_decode_test.cpp) and timed
+// (benchmarks/tga_decode_bench.cpp) against. Rows are kept in file order, like TGAImage does since it has an origin.
+struct ReferenceTGA {
+  int width = 0;
+  int height = 0;
+  int bytespp = 0;
+  bool top_left = false;
+  std::vector<unsigned char> data;
+};
+
+inline bool read_reference_tga(const char* filename, ReferenceTGA& image) {
+  std::ifstream in(filename, std::ios::binary);
+  unsigned char header[18];
+  if (!in.read(reinterpret_cast<char*>(header), sizeof(header)))
+    return false;
+  image.width = header[12] | header[13] << 8;
+  image.height = header[14] | header[15] << 8;
+  image.bytespp = header[16] >> 3;
+  image.top_left = header[17] & 0x20;
+  if (image.width <= 0 || image.height <= 0 || (image.bytespp != 1 && image.bytespp != 3 && image.bytespp != 4))
+    return false;
+  in.ignore(header[0]);
+
+  const size_t pixel_count = size_t(image.width) * image.height;
+  image.data.assign(pixel_count * image.bytespp, 0);
+  const int type = header[2];
+  if (type == 2 || type == 3) {
+    if (!in.read(reinterpret_cast<char*>(image.data.data()), image.data.size()))
+      return false;
+  } else if (type == 10 || type == 11) {
+    size_t pixel = 0;
+    unsigned char color[4];
+    while (pixel < pixel_count) {
+      const int chunk_header = in.get();
+      if (!in.good())
+        return false;
+      const size_t count = (chunk_header & 0x7F) + 1;
+      if (pixel + count > pixel_count)
+        return false;
+      for (size_t i = 0; i < count; ++i, ++pixel) {
+        if ((chunk_header < 128 || i == 0) && !in.read(reinterpret_cast<char*>(color), image.bytespp))
+          return false;
+        std::copy(color, color + image.bytespp, image.data.begin() + pixel * image.bytespp);
+      }
+    }
+  } else {
+    return false;
+  }
+
+  // right to left rows are mirrored, TGAImage does the same
+  if (header[17] & 0x10) {
+    for (int y = 0; y < image.height; ++y) {
+      unsigned char* row = image.data.data() + size_t(y) * image.width * image.bytespp;
+      for (int l = 0, r = image.width - 1; l < r; ++l, --r)
+        std::swap_ranges(row + l * image.bytespp, row + (l + 1) * image.bytespp, row + r * image.bytespp);
+    }
+  }
+  return true;
+}
@@ -0,0 +1,288 @@
+#pragma once
+
+#include "block_compression.hpp"
+#include "tga_color.hpp"
+#include "tgaimage.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Read-only texture with a full mip chain, converted once from a TGAImage at load time. Texels are BGRA8 words
+// (TGAColor::val) and every level starts on its own cache line, so a fetch is one aligned 32-bit load instead of
+// TGAImage::get's bounds check and bytespp sized copy.
+// `sample` filters trilinearly: minified triangles read from a small mip that stays in cache rather than striding
+// across the full resolution image.
+class Texture2D {
+public:
+  enum Layout {
+    // rows one after another, like TGAImage
+    LINEAR,
+    // 4x4 texel tiles of one cache line each, Z-order inside a tile and tiles row by row. A footprint that walks
+    // along v stays within a line for 4 texels instead of touching a new one every texel.
+    TILED,
+    // 4x4 texel BC1 blocks of 8 bytes, row by row: 4 bits per texel, alpha is dropped. Blocks are decoded on demand
+    // into a small per thread cache, see decoded_block.
+    BC1
+  };
+
+  static constexpr int TILE_SIZE = 4;
+
+  // `image` is a TGAImage or a TGAView. Level rows go up from the bottom of the picture, as v does.
+  template<class Image>
+  explicit Texture2D(Image& image, Layout layout = LINEAR)
+    : layout(layout == BC1 ? LINEAR : layout)
+    , id(next_id()) {
+    int width = image.get_width();
+    int height = image.get_height();
+    allocate_levels(width, height);
+
+    uint32_t* base = texels(0);
+    const bool grayscale = image.get_bytespp() == TGAImage::GRAYSCALE;
+    for (int y = 0; y < height; ++y) {
+      const int row = image.row_from_bottom(y);
+      for (int x = 0; x < width; ++x) {
+        TGAColor color = image.get(x, row);
+        if (grayscale)
+          color.g = color.r = color.b;
+        if (image.get_bytespp() != TGAImage::RGBA)
+          color.a = 255;
+        base[address(levels[0], x, y)] = color.val;
+      }
+    }
+
+    // 2x2 box filter, the odd row or column of a level is folded into its neighbour by clamping
+    for (size_t level = 1; level < levels.size(); ++level) {
+      const Level& src = levels[level - 1];
+      const Level& dst = levels[level];
+      const uint32_t* in = texels(level - 1);
+      uint32_t* out = texels(level);
+      for (int y = 0; y < dst.height; ++y) {
+        const int y0 = std::min(2 * y, src.height - 1);
+        const int y1 = std::min(2 * y + 1, src.height - 1);
+        for (int x = 0; x < dst.width; ++x) {
+          const int x0 = std::min(2 * x, src.width - 1);
+          const int x1 = std::min(2 * x + 1, src.width - 1);
+          const uint32_t quad[4] = { in[address(src, x0, y0)], in[address(src, x1, y0)], in[address(src, x0, y1)], in[address(src, x1, y1)] };
+          uint32_t texel = 0;
+          for (int shift = 0; shift < 32; shift += 8) {
+            uint32_t sum = 2;
+            for (uint32_t t : quad)
+              sum += (t >> shift) & 0xFF;
+            texel |= (sum / 4) << shift;
+          }
+          out[address(dst, x, y)] = texel;
+        }
+      }
+    }
+
+    // the chain is built uncompressed first so every level is filtered from full precision texels
+    if (layout == BC1)
+      compress();
+  }
+
+  int get_width(int level = 0) const { return levels[level].width; }
+  int get_height(int level = 0) const { return levels[level].height; }
+  int level_count() const { return levels.size(); }
+  Layout get_layout() const { return layout; }
+
+  // Bytes held by the texels of all levels
+  size_t size_bytes() const { return storage.size() * sizeof(CacheLine) + blocks.size() * sizeof(uint64_t); }
+
+  // Texel of a level, coordinates are clamped to the edge
+  TGAColor fetch(int level, int x, int y) const {
+    const Level& l = levels[level];
+    x = std::clamp(x, 0, l.width - 1);
+    y = std::clamp(y, 0, l.height - 1);
+    if (layout == BC1)
+      return TGAColor(compressed_texel(l, x, y));
+    return TGAColor(texels(level)[address(l, x, y)]);
+  }
+
+  // Level of detail for a footprint with the given texture coordinate derivatives per screen pixel:
+  // log2 of the longer axis measured in level 0 texels
+  float_t lod(glm::vec2 duv_dx, glm::vec2 duv_dy) const {
+    const glm::vec2 size{ levels[0].width, levels[0].height };
+    const glm::vec2 dx = duv_dx * size;
+    const glm::vec2 dy = duv_dy * size;
+    const float_t rho2 = std::max(glm::dot(dx, dx), glm::dot(dy, dy));
+    return rho2 > 0 ? 0.5f * std::log2(rho2) : 0;
+  }
+
+  // Trilinear sample: bilinear in the two levels around `lod`, blended. Magnification (lod <= 0) stays bilinear
+  // in level 0.
+  TGAColor sample(glm::vec2 uv, float_t lod) const {
+    lod = std::clamp(lod, 0.0f, float_t(levels.size() - 1));
+    const int level = int(lod);
+    const float_t t = lod - level;
+
+    glm::vec4 color = bilinear(level, uv);
+    if (t > 0)
+      color = glm::mix(color, bilinear(level + 1, uv), t);
+
+    TGAColor out;
+    out.bytespp = 4;
+    out.b = color.x + 0.5f;
+    out.g = color.y + 0.5f;
+    out.r = color.z + 0.5f;
+    out.a = color.w + 0.5f;
+    return out;
+  }
+
+private:
+  struct alignas(64) CacheLine {
+    uint32_t texels[16];
+  };
+
+  static_assert(sizeof(CacheLine) / sizeof(uint32_t) == TILE_SIZE * TILE_SIZE, "a tile is one cache line");
+
+  struct Level {
+    int width;
+    int height;
+    // first texel, first block with BC1
+    size_t offset;
+    // tiles (or blocks) per row with TILED and BC1, unused with LINEAR
+    int tiles_x;
+  };
+
+  // Direct mapped, keyed by texture id and block, so a texture that is destroyed and another one allocated in its
+  // place can't hit stale entries. 64 blocks of 16 texels, 4 KiB per thread.
+  struct BlockCache {
+    static constexpr size_t SIZE = 64;
+    uint64_t tags[SIZE];
+    CacheLine lines[SIZE];
+
+    BlockCache() { std::fill(std::begin(tags), std::end(tags), ~uint64_t(0)); }
+  };
+
+  static uint32_t next_id() {
+    static std::atomic<uint32_t> counter{ 0 };
+    return counter.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void compress() {
+    std::vector<uint64_t> encoded;
+    for (size_t level = 0; level < levels.size(); ++level) {
+      Level& l = levels[level];
+      const int blocks_y = (l.height + BC1_BLOCK_SIZE - 1) / BC1_BLOCK_SIZE;
+      const uint32_t* in = texels(level);
+      const size_t offset = encoded.size();
+      for (int by = 0; by < blocks_y; ++by) {
+        for (int bx = 0; bx < l.tiles_x; ++bx) {
+          // partial blocks at the right and bottom edge repeat the last texel
+          uint32_t block[16];
+          for (int i = 0; i < 16; ++i) {
+            const int x = std::min(bx * BC1_BLOCK_SIZE + i % 4, l.width - 1);
+            const int y = std::min(by * BC1_BLOCK_SIZE + i / 4, l.height - 1);
+            block[i] = in[address(l, x, y)];
+          }
+          encoded.push_back(encode_bc1_block(block));
+        }
+      }
+      l.offset = offset;
+    }
+    layout = BC1;
+    blocks = std::move(encoded);
+    storage = {};
+  }
+
+  // The 16 texels of the block containing (x, y)
+  const uint32_t* decoded_block(const Level& l, int x, int y) const {
+    static thread_local BlockCache cache;
+    const size_t block = l.offset + size_t(x >> 2) + size_t(y >> 2) * l.tiles_x;
+    const uint64_t tag = uint64_t(id) << 32 | block;
+    const size_t slot = (block ^ block >> 6 ^ id) % BlockCache::SIZE;
+    if (cache.tags[slot] != tag) {
+      decode_bc1_block(blocks[block], cache.lines[slot].texels);
+      cache.tags[slot] = tag;
+    }
+    return cache.lines[slot].texels;
+  }
+
+  // Allocates the uncompressed chain, BC1 textures are built LINEAR and compressed afterwards
+  void allocate_levels(int width, int height) {
+    constexpr size_t texels_per_line = sizeof(CacheLine) / sizeof(uint32_t);
+    size_t lines = 0;
+    for (;;) {
+      const int tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+      const int tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+      levels.push_back(Level{ width, height, lines * texels_per_line, tiles_x });
+      if (layout == TILED)
+        lines += size_t(tiles_x) * tiles_y;
+      else
+        lines += (size_t(width) * height + texels_per_line - 1) / texels_per_line;
+      if (width == 1 && height == 1)
+        break;
+      width = std::max(1, width / 2);
+      height = std::max(1, height / 2);
+    }
+    storage.resize(lines);
+  }
+
+  uint32_t* texels(size_t level) { return storage.data()->texels + levels[level].offset; }
+  const uint32_t* texels(size_t level) const { return storage.data()->texels + levels[level].offset; }
+
+  // Texel index within a level is column(x) + row(y) in both layouts, so a bilinear footprint needs two of each.
+  // For TILED the tile picks the line and the two low bits of x and y, interleaved, the texel within it: y1 x1 y0 x0.
+  size_t column(const Level&, int x) const {
+    if (layout == LINEAR)
+      return x;
+    return size_t(x >> 2) * (TILE_SIZE * TILE_SIZE) + ((x & 1) | (x & 2) << 1);
+  }
+
+  size_t row(const Level& l, int y) const {
+    if (layout == LINEAR)
+      return size_t(y) * l.width;
+    return size_t(y >> 2) * l.tiles_x * (TILE_SIZE * TILE_SIZE) + ((y & 1) << 1 | (y & 2) << 2);
+  }
+
+  size_t address(const Level& l, int x, int y) const { return column(l, x) + row(l, y); }
+
+  uint32_t compressed_texel(const Level& l, int x, int y) const {
+    return decoded_block(l, x, y)[(x & 3) + (y & 3) * BC1_BLOCK_SIZE];
+  }
+
+  static glm::vec4 unpack(uint32_t texel) {
+    return glm::vec4(texel & 0xFF, (texel >> 8) & 0xFF, (texel >> 16) & 0xFF, texel >> 24);
+  }
+
+  // Texel centers sit at half integers, like TGAImage::get sampled at (u * width, v * height)
+  glm::vec4 bilinear(int level, glm::vec2 uv) const {
+    const Level& l = levels[level];
+    const float_t x = uv.x * l.width - 0.5f;
+    const float_t y = uv.y * l.height - 0.5f;
+    const float_t fx = std::floor(x);
+    const float_t fy = std::floor(y);
+    const float_t tx = x - fx;
+    const float_t ty = y - fy;
+
+    const int x0 = std::clamp(int(fx), 0, l.width - 1);
+    const int y0 = std::clamp(int(fy), 0, l.height - 1);
+    const int x1 = std::clamp(int(fx) + 1, 0, l.width - 1);
+    const int y1 = std::clamp(int(fy) + 1, 0, l.height - 1);
+    if (layout == BC1) {
+      const glm::vec4 top = glm::mix(unpack(compressed_texel(l, x0, y0)), unpack(compressed_texel(l, x1, y0)), tx);
+      const glm::vec4 bottom = glm::mix(unpack(compressed_texel(l, x0, y1)), unpack(compressed_texel(l, x1, y1)), tx);
+      return glm::mix(top, bottom, ty);
+    }
+    const uint32_t* top_row = texels(level) + row(l, y0);
+    const uint32_t* bottom_row = texels(level) + row(l, y1);
+    const size_t left = column(l, x0);
+    const size_t right = column(l, x1);
+
+    const glm::vec4 top = glm::mix(unpack(top_row[left]), unpack(top_row[right]), tx);
+    const glm::vec4 bottom = glm::mix(unpack(bottom_row[left]), unpack(bottom_row[right]), tx);
+    return glm::mix(top, bottom, ty);
+  }
+
+  Layout layout;
+  uint32_t id;
+  std::vector<Level> levels;
+  std::vector<CacheLine> storage;
+  std::vector<uint64_t> blocks;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "tga_color.hpp"
+#include "tga_header.hpp"
+#include "tgaimage.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+
+// Zero copy read-only view of an uncompressed (type 2 or 3) TGA file. The file is mapped and the pixels are used
+// where they lie, addressed like a TGAImage after read_tga_file: rows as stored, get_origin() says which way they
+// go. Interchangeable with TGAImage wherever an image is only read, e.g. Texture2D.
+class TGAView {
+public:
+  using Origin = TGAImage::Origin;
+
+  bool open(const char* filename) {
+    width = height = bytespp = 0;
+    pixels = nullptr;
+    if (!file.open(filename)) {
+      std::cerr << "can't open file " << filename << "\n";
+      return false;
+    }
+    TGA_Header header;
+    if (file.size() < sizeof(header)) {
+      std::cerr << "an error occured while reading the header\n";
+      return false;
+    }
+    memcpy(&header, file.data(), sizeof(header));
+    if (header.datatypecode != 2 && header.datatypecode != 3) {
+      std::cerr << "only uncompressed files can be mapped, use TGAImage::read_tga_file\n";
+      return false;
+    }
+    // right to left rows would need a copy to address, they aren't worth supporting
+    if (header.imagedescriptor & 0x10) {
+      std::cerr << "right to left files can't be mapped, use TGAImage::read_tga_file\n";
+      return false;
+    }
+    const int bpp = header.bitsperpixel >> 3;
+    if (header.width <= 0 || header.height <= 0 || (bpp != 1 && bpp != 3 && bpp != 4)) {
+      std::cerr << "bad bpp (or width/height) value\n";
+      return false;
+    }
+    const size_t offset = sizeof(header) + (unsigned char)header.idlength;
+    if (file.size() < offset + size_t(header.width) * header.height * bpp) {
+      std::cerr << "an error occured while reading the data\n";
+      return false;
+    }
+
+    width = header.width;
+    height = header.height;
+    bytespp = bpp;
+    origin = header.imagedescriptor & 0x20 ? TGAImage::TOP_LEFT : TGAImage::BOTTOM_LEFT;
+    pixels = file.data() + offset;
+    return true;
+  }
+
+  int get_width() const { return width; }
+  int get_height() const { return height; }
+  int get_bytespp() const { return bytespp; }
+  Origin get_origin() const { return origin; }
+
+  // Stored row y, bytespp bytes per pixel
+  const unsigned char* row(int y) const { return pixels + size_t(y) * width * bytespp; }
+
+  // See TGAImage::row_from_bottom
+  int row_from_bottom(int y) const { return origin == TGAImage::BOTTOM_LEFT ? y : height - 1 - y; }
+
+  TGAColor get(int x, int y) const {
+    if (!pixels || x < 0 || y < 0 || x >= width || y >= height)
+      return TGAColor();
+    return TGAColor(row(y) + size_t(x) * bytespp, bytespp);
+  }
+
+private:
+  MappedFile file;
+  const unsigned char* pixels = nullptr;
+  int width = 0;
+  int height = 0;
+  int bytespp = 0;
+  Origin origin = TGAImage::TOP_LEFT;
+};
@@ -1,17 +1,30 @@
 #include "tgaimage.hpp"
 #include "glm/fwd.hpp"
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include "resample.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <string.h>
 #include <time.h>
 #include <math.h>
+#include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
 
-TGAImage::TGAImage() : data(NULL), width(0), height(0), bytespp(0) {
+
+TGAImage::TGAImage() : data(NULL), width(0), height(0), bytespp(0), origin(TOP_LEFT) {
 }
 
-TGAImage::TGAImage(int w, int h, int bpp) : data(NULL), width(w), height(h), bytespp(bpp) {
+TGAImage::TGAImage(int w, int h, int bpp, Origin origin) : data(NULL), width(w), height(h), bytespp(bpp), origin(origin) {
 	unsigned long nbytes = width*height*bytespp;
 	data = new unsigned char[nbytes];
 	memset(data, 0, nbytes);
@@ -21,6 +34,7 @@ TGAImage::TGAImage(const TGAImage &img) {
 	width = img.width;
 	height = img.height;
 	bytespp = img.bytespp;
+	origin = img.origin;
 	unsigned long nbytes = width*height*bytespp;
 	data = new unsigned char[nbytes];
 	memcpy(data, img.data, nbytes);
@@ -36,6 +50,7 @@ TGAImage & TGAImage::operator =(const TGAImage &img) {
 		width  = img.width;
 		height = img.height;
 		bytespp = img.bytespp;
+		origin = img.origin;
 		unsigned long nbytes = width*height*bytespp;
 		data = new unsigned char[nbytes];
 		memcpy(data, img.data, nbytes);
@@ -46,109 +61,107 @@ TGAImage & TGAImage::operator =(const TGAImage &img) {
 bool TGAImage::read_tga_file(const char *filename) {
 	if (data) delete [] data;
 	data = NULL;
-	std::ifstream in;
-	in.open (filename, std::ios::binary);
-	if (!in.is_open()) {
+	MappedFile file;
+	if (!file.open(filename)) {
 		std::cerr << "can't open file " << filename << "\n";
-		in.close();
 		return false;
 	}
+	file.will_need();
 	TGA_Header header;
-	in.read((char *)&header, sizeof(header));
-	if (!in.good()) {
-		in.close();
+	if (file.size() < sizeof(header)) {
 		std::cerr << "an error occured while reading the header\n";
 		return false;
 	}
+	memcpy(&header, file.data(), sizeof(header));
 	width   = header.width;
 	height  = header.height;
 	bytespp = header.bitsperpixel>>3;
 	if (width<=0 || height<=0 || (bytespp!=GRAYSCALE && bytespp!=RGB && bytespp!=RGBA)) {
-		in.close();
 		std::cerr << "bad bpp (or width/height) value\n";
 		return false;
 	}
+	// pixel data follows the header and the optional image id
+	const unsigned long offset = sizeof(header) + (unsigned char)header.idlength;
+	const unsigned char *in = file.data() + std::min<size_t>(offset, file.size());
+	const unsigned long available = file.size() - (in - file.data());
 	unsigned long nbytes = bytespp*width*height;
 	data = new unsigned char[nbytes];
 	if (3==header.datatypecode || 2==header.datatypecode) {
-		in.read((char *)data, nbytes);
-		if (!in.good()) {
-			in.close();
+		if (available < nbytes) {
 			std::cerr << "an error occured while reading the data\n";
 			return false;
 		}
+		memcpy(data, in, nbytes);
 	} else if (10==header.datatypecode||11==header.datatypecode) {
-		if (!load_rle_data(in)) {
-			in.close();
+		if (!load_rle_data(in, available)) {
 			std::cerr << "an error occured while reading the data\n";
 			return false;
 		}
 	} else {
-		in.close();
 		std::cerr << "unknown file format " << (int)header.datatypecode << "\n";
 		return false;
 	}
-	if (!(header.imagedescriptor & 0x20)) {
-		flip_vertically();
-	}
+	// rows stay in file order, the origin says which way they go
+	origin = header.imagedescriptor & 0x20 ? TOP_LEFT : BOTTOM_LEFT;
 	if (header.imagedescriptor & 0x10) {
 		flip_horizontally();
 	}
 	std::cerr << width << "x" << height << "/" << bytespp*8 << "\n";
-	in.close();
 	return true;
 }
 
-bool TGAImage::load_rle_data(std::ifstream &in) {
-	unsigned long pixelcount = width*height;
-	unsigned long currentpixel = 0;
-	unsigned long currentbyte  = 0;
-	TGAColor colorbuffer;
-	do {
-		unsigned char chunkheader = 0;
-		chunkheader = in.get();
-		if (!in.good()) {
+// Decodes from memory: a raw packet is one memcpy, a run packet is a memset for grayscale and otherwise replicates
+// its pixel into a 48 byte pattern (a whole number of pixels for every bytespp) copied out 48 bytes at a time
+bool TGAImage::load_rle_data(const unsigned char *in, unsigned long size) {
+	const unsigned long nbytes = width*height*bytespp;
+	const unsigned char *end = in + size;
+	unsigned long currentbyte = 0;
+	unsigned char pattern[48];
+	while (currentbyte < nbytes) {
+		if (in == end) {
 			std::cerr << "an error occured while reading the data\n";
 			return false;
 		}
+		const unsigned char chunkheader = *in++;
+		const unsigned long chunkbytes = ((chunkheader & 0x7F) + 1) * bytespp;
+		if (currentbyte + chunkbytes > nbytes) {
+			std::cerr << "Too many pixels read\n";
+			return false;
+		}
 		if (chunkheader<128) {
-			chunkheader++;
-			for (int i=0; i<chunkheader; i++) {
-				in.read((char *)colorbuffer.raw, bytespp);
-				if (!in.good()) {
-					std::cerr << "an error occured while reading the header\n";
-					return false;
-				}
-				for (int t=0; t<bytespp; t++)
-					data[currentbyte++] = colorbuffer.raw[t];
-				currentpixel++;
-				if (currentpixel>pixelcount) {
-					std::cerr << "Too many pixels read\n";
-					return false;
-				}
+			if ((unsigned long)(end - in) < chunkbytes) {
+				std::cerr << "an error occured while reading the header\n";
+				return false;
 			}
+			memcpy(data+currentbyte, in, chunkbytes);
+			in += chunkbytes;
 		} else {
-			chunkheader -= 127;
-			in.read((char *)colorbuffer.raw, bytespp);
-			if (!in.good()) {
+			if (end - in < bytespp) {
 				std::cerr << "an error occured while reading the header\n";
 				return false;
 			}
-			for (int i=0; i<chunkheader; i++) {
-				for (int t=0; t<bytespp; t++)
-					data[currentbyte++] = colorbuffer.raw[t];
-				currentpixel++;
-				if (currentpixel>pixelcount) {
-					std::cerr << "Too many pixels read\n";
-					return false;
-				}
+			unsigned char *out = data+currentbyte;
+			if (bytespp==1) {
+				memset(out, *in, chunkbytes);
+			} else {
+				// the pattern doubles until it covers the packet or its 48 bytes
+				const unsigned long patternbytes = std::min<unsigned long>(chunkbytes, sizeof(pattern));
+				memcpy(pattern, in, bytespp);
+				for (unsigned long filled=bytespp; filled<patternbytes; filled*=2)
+					memcpy(pattern+filled, pattern, std::min(filled, patternbytes-filled));
+				unsigned long left = chunkbytes;
+				for (; left>=sizeof(pattern); left-=sizeof(pattern), out+=sizeof(pattern))
+					memcpy(out, pattern, sizeof(pattern));
+				memcpy(out, pattern, left);
 			}
+			in += bytespp;
 		}
-	} while (currentpixel < pixelcount);
+		currentbyte += chunkbytes;
+	}
 	return true;
 }
 
-bool TGAImage::write_tga_file(const char *filename, bool rle) {
+bool TGAImage::write_tga_file(const char *filename, bool rle, bool parallel) {
 	unsigned char developer_area_ref[4] = {0, 0, 0, 0};
 	unsigned char extension_area_ref[4] = {0, 0, 0, 0};
 	unsigned char footer[18] = {'T','R','U','E','V','I','S','I','O','N','-','X','F','I','L','E','.','\0'};
@@ -165,7 +178,7 @@ bool TGAImage::write_tga_file(const char *filename, bool rle) {
 	header.width  = width;
 	header.height = height;
 	header.datatypecode = (bytespp==GRAYSCALE?(rle?11:3):(rle?10:2));
-	header.imagedescriptor = 0x20; // top-left origin
+	header.imagedescriptor = origin==TOP_LEFT ? 0x20 : 0;
 	out.write((char *)&header, sizeof(header));
 	if (!out.good()) {
 		out.close();
@@ -180,7 +193,7 @@ bool TGAImage::write_tga_file(const char *filename, bool rle) {
 			return false;
 		}
 	} else {
-		if (!unload_rle_data(out)) {
+		if (!unload_rle_data(out, parallel)) {
 			out.close();
 			std::cerr << "can't unload rle data\n";
 			return false;
@@ -208,49 +221,498 @@ bool TGAImage::write_tga_file(const char *filename, bool rle) {
 	return true;
 }
 
-// TODO: it is not necessary to break a raw chunk for two equal pixels (for the matter of the resulting size)
-bool TGAImage::unload_rle_data(std::ofstream &out) {
-	const unsigned char max_chunk_length = 128;
-	unsigned long npixels = width*height;
-	unsigned long curpix = 0;
-	while (curpix<npixels) {
-		unsigned long chunkstart = curpix*bytespp;
-		unsigned long curbyte = curpix*bytespp;
-		unsigned char run_length = 1;
-		bool raw = true;
-		while (curpix+run_length<npixels && run_length<max_chunk_length) {
-			bool succ_eq = true;
-			for (int t=0; succ_eq && t<bytespp; t++) {
-				succ_eq = (data[curbyte+t]==data[curbyte+t+bytespp]);
+namespace {
+
+// Scratch space of the scanline RLE encoder, sized for one row and reused for every row
+struct RLEScratch {
+	std::vector<unsigned char> equal;  // equal[x] != 0: pixel x repeats pixel x-1
+	std::vector<long> cost;            // cost[x]: fewest bytes that encode the first x pixels
+	std::vector<int> packet;           // packet[x]: length of the last packet of that encoding, negative for a run
+	std::vector<int> window;           // raw packet starts by increasing key, see encode_rle_row_optimal
+	std::vector<long> keys;
+
+	explicit RLEScratch(int width)
+		: equal(width), cost(width+1), packet(width+1), window(width+1), keys(width+1) {
+	}
+};
+
+// Appends boundary i to the monotonic window [head, tail), returns the new tail
+inline int push_window(int *window, long *keys, int head, int tail, int i, long key) {
+	while (tail>head && keys[tail-1]>=key)
+		tail--;
+	window[tail] = i;
+	keys[tail] = key;
+	return tail+1;
+}
+
+// Flags every pixel equal to its left neighbour, 16 pixels per step with SSE2
+void find_repeats(const unsigned char *row, int width, int bytespp, unsigned char *equal) {
+	int x = 1;
+#if defined(__SSE2__)
+	if (bytespp==1) {
+		for (; x+16<=width; x+=16) {
+			const __m128i cur  = _mm_loadu_si128((const __m128i *)(row+x));
+			const __m128i prev = _mm_loadu_si128((const __m128i *)(row+x-1));
+			_mm_storeu_si128((__m128i *)(equal+x), _mm_cmpeq_epi8(cur, prev));
+		}
+	} else if (bytespp==4) {
+		for (; x+16<=width; x+=16) {
+			__m128i eq[4];
+			for (int k=0; k<4; k++) {
+				const __m128i cur  = _mm_loadu_si128((const __m128i *)(row+(x+4*k)*4));
+				const __m128i prev = _mm_loadu_si128((const __m128i *)(row+(x+4*k-1)*4));
+				eq[k] = _mm_cmpeq_epi32(cur, prev);
 			}
-			curbyte += bytespp;
-			if (1==run_length) {
-				raw = !succ_eq;
+			const __m128i packed = _mm_packs_epi16(_mm_packs_epi32(eq[0], eq[1]), _mm_packs_epi32(eq[2], eq[3]));
+			_mm_storeu_si128((__m128i *)(equal+x), packed);
+		}
+	} else {
+		// 16 pixels are 48 bytes, a pixel is equal when all three of its byte compares are
+		for (; x+16<=width; x+=16) {
+			uint64_t mask = 0;
+			for (int k=0; k<3; k++) {
+				const __m128i cur  = _mm_loadu_si128((const __m128i *)(row+x*3+16*k));
+				const __m128i prev = _mm_loadu_si128((const __m128i *)(row+x*3+16*k-3));
+				mask |= uint64_t(_mm_movemask_epi8(_mm_cmpeq_epi8(cur, prev))) << (16*k);
 			}
-			if (raw && succ_eq) {
-				run_length--;
-				break;
+			mask &= (mask>>1) & (mask>>2);
+			for (int k=0; k<16; k++)
+				equal[x+k] = (mask >> (3*k)) & 1;
+		}
+	}
+#endif
+	for (; x<width; x++)
+		equal[x] = !memcmp(row+x*bytespp, row+(x-1)*bytespp, bytespp);
+}
+
+// Raw packets of at most 128 pixels for the `count` pixels at `src`
+inline unsigned char *emit_raw(unsigned char *dst, const unsigned char *src, int count, int bytespp) {
+	while (count>0) {
+		const int length = std::min(count, 128);
+		*dst++ = length-1;
+		memcpy(dst, src, length*bytespp);
+		dst += length*bytespp;
+		src += length*bytespp;
+		count -= length;
+	}
+	return dst;
+}
+
+// For two or more bytes per pixel every run of at least two pixels goes into run packets: as a run it costs
+// 1 + bytespp bytes plus at most one extra raw packet header where it splits a raw stretch, never more than the
+// 2 * bytespp of two raw pixels. A single pixel left over after 128 pixel run packets is never worse off raw, best
+// joining the raw stretch in front of the run when that has room in its last packet, otherwise starting the next.
+// Greedy is therefore optimal and needs no search (tests/rle_test.cpp checks it against a brute force search).
+unsigned char *encode_rle_row_greedy(const unsigned char *row, int width, int bytespp, const unsigned char *equal, unsigned char *dst) {
+	int literal_start = 0;
+	int x = 0;
+	while (x<width) {
+		if (x+1==width || !equal[x+1]) {
+			x++;
+			continue;
+		}
+		const unsigned char *end = (const unsigned char *)memchr(equal+x+1, 0, width-x-1);
+		const int run_end = end ? end-equal : width;
+		// a run of 128k+1 pixels gives its first pixel to the raw stretch in front when that costs no header
+		if ((run_end-x)%128==1 && x>literal_start && (x-literal_start)%128)
+			x++;
+		dst = emit_raw(dst, row+literal_start*bytespp, x-literal_start, bytespp);
+		for (int length=run_end-x; length>=2; length=run_end-x) {
+			const int chunk = std::min(length, 128);
+			*dst++ = chunk+127;
+			memcpy(dst, row+x*bytespp, bytespp);
+			dst += bytespp;
+			x += chunk;
+		}
+		// any other leftover single pixel starts the next raw stretch
+		literal_start = x;
+		x = run_end;
+	}
+	return emit_raw(dst, row+literal_start*bytespp, width-literal_start, bytespp);
+}
+
+// One byte per pixel breaks the greedy argument above (two equal raw pixels cost exactly a run packet, so whether
+// to split depends on the neighbours), these rows are searched exhaustively for the fewest bytes:
+// cost[j] = min(cost[i] + 1 + (j-i)*bytespp over the last 128 boundaries i (a raw packet),
+//               cost[i] + 1 + bytespp over the boundaries i inside the run of equal pixels ending at j (a run packet)).
+// The raw minimum is kept in a monotonic sliding window. cost never decreases, so the best run start is the
+// leftmost allowed one, and more than 128 pixels into a run a raw packet can't win at all.
+unsigned char *encode_rle_row_optimal(const unsigned char *row, int width, int bytespp, RLEScratch &s, unsigned char *dst) {
+	const int max_chunk_length = 128;
+	const unsigned char *equal = s.equal.data();
+	long *cost = s.cost.data();
+	int *packet = s.packet.data();
+	int *window = s.window.data();
+	long *keys = s.keys.data();
+
+	// the raw window holds boundaries i by increasing key cost[i] - i*bytespp
+	int head = 0, tail = 0;
+	int run_start = 0;
+	cost[0] = 0;
+	for (int j=1; j<=width; j++) {
+		const bool repeat = j>1 && equal[j-1];
+		if (!repeat)
+			run_start = j-1;
+		if (j-run_start > max_chunk_length) {
+			cost[j] = cost[j-max_chunk_length] + 1 + bytespp;
+			packet[j] = -max_chunk_length;
+			// leaving a long run, the raw window is rebuilt from the boundaries skipped meanwhile
+			if (j==width || !equal[j]) {
+				head = tail = 0;
+				for (int i=j-max_chunk_length; i<j; i++)
+					tail = push_window(window, keys, head, tail, i, cost[i] - long(i)*bytespp);
 			}
-			if (!raw && !succ_eq) {
-				break;
+			continue;
+		}
+
+		tail = push_window(window, keys, head, tail, j-1, cost[j-1] - long(j-1)*bytespp);
+		if (window[head] < j-max_chunk_length)
+			head++;
+		const int start = window[head];
+		cost[j] = cost[start] + 1 + long(j-start)*bytespp;
+		packet[j] = j-start;
+		if (repeat && cost[run_start] + 1 + bytespp < cost[j]) {
+			cost[j] = cost[run_start] + 1 + bytespp;
+			packet[j] = -(j-run_start);
+		}
+	}
+
+	// walk the choices back from the end of the row, then emit them front to back
+	int count = 0;
+	for (int j=width; j>0; j-=std::abs(packet[j]))
+		window[count++] = packet[j];
+	const unsigned char *src = row;
+	while (count--) {
+		const int length = window[count];
+		if (length>0) {
+			*dst++ = length-1;
+			memcpy(dst, src, length*bytespp);
+			dst += length*bytespp;
+			src += length*bytespp;
+		} else {
+			*dst++ = -length+127;
+			memcpy(dst, src, bytespp);
+			dst += bytespp;
+			src -= length*bytespp;
+		}
+	}
+	return dst;
+}
+
+// Appends the packets of one scanline to `out`, as few bytes as possible
+void encode_rle_row(const unsigned char *row, int width, int bytespp, RLEScratch &s, std::vector<unsigned char> &out) {
+	find_repeats(row, width, bytespp, s.equal.data());
+	// never more than the row as raw packets
+	const size_t size = out.size();
+	out.resize(size + width*bytespp + (width+127)/128);
+	unsigned char *dst = out.data() + size;
+	if (bytespp==1)
+		dst = encode_rle_row_optimal(row, width, bytespp, s, dst);
+	else
+		dst = encode_rle_row_greedy(row, width, bytespp, s.equal.data(), dst);
+	out.resize(dst - out.data());
+}
+
+}
+
+// Packets never cross a scanline (as TGA 2.0 requires), so the image is cut into bands of rows that are encoded
+// into buffers of their own and written out in order. With `parallel` as many bands as there are threads are
+// encoded at a time, the bytes are the same either way.
+bool TGAImage::unload_rle_data(std::ofstream &out, bool parallel) {
+	const unsigned long band_bytes = 1<<20;
+	const unsigned long row_bytes = width*bytespp;
+	const int band_rows = std::max<unsigned long>(1, band_bytes/row_bytes);
+	const int bands = (height+band_rows-1)/band_rows;
+	const int in_flight = parallel ? std::min<int>(bands, hardware_threads()) : 1;
+	std::vector<std::vector<unsigned char>> buffers(in_flight);
+	for (int first=0; first<bands; first+=in_flight) {
+		const int count = std::min(in_flight, bands-first);
+		parallel_for(count, [&](size_t i) {
+			RLEScratch scratch(width);
+			std::vector<unsigned char> &buffer = buffers[i];
+			buffer.clear();
+			const int y_begin = (first+i)*band_rows;
+			const int y_end = std::min(height, y_begin+band_rows);
+			for (int y=y_begin; y<y_end; y++)
+				encode_rle_row(data+y*row_bytes, width, bytespp, scratch, buffer);
+		});
+		for (int i=0; i<count; i++) {
+			out.write((char *)buffers[i].data(), buffers[i].size());
+			if (!out.good()) {
+				std::cerr << "can't dump the tga file\n";
+				return false;
 			}
-			run_length++;
 		}
-		curpix += run_length;
-		out.put(raw?run_length-1:run_length+127);
-		if (!out.good()) {
-			std::cerr << "can't dump the tga file\n";
-			return false;
+	}
+	return true;
+}
+
+namespace {
+
+const unsigned char QOI_OP_INDEX = 0x00;
+const unsigned char QOI_OP_DIFF  = 0x40;
+const unsigned char QOI_OP_LUMA  = 0x80;
+const unsigned char QOI_OP_RUN   = 0xc0;
+const unsigned char QOI_OP_RGB   = 0xfe;
+const unsigned char QOI_OP_RGBA  = 0xff;
+const unsigned char QOI_MASK_2   = 0xc0;
+const unsigned char qoi_magic[4] = {'q','o','i','f'};
+const unsigned char qoi_end_marker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+const unsigned long qoi_header_size = 14;
+// the limit of the reference implementation, also keeps width*height*bytespp in range
+const unsigned long qoi_pixels_max = 400000000;
+
+// Pixels are handled as r | g<<8 | b<<16 | a<<24 so that comparing two of them is one compare
+inline uint32_t qoi_pack(unsigned r, unsigned g, unsigned b, unsigned a) {
+	return r | g<<8 | b<<16 | a<<24;
+}
+
+// (r*3 + g*5 + b*7 + a*11) % 64 in one multiply: with r, b, g, a spread to bits 0, 16, 32, 48 every product lands
+// in the top byte only for the wanted pairs, and everything below stays under bit 55 so nothing carries into it
+inline unsigned qoi_hash(uint32_t px) {
+	const uint64_t spread = (px&0x00ff00ff) | uint64_t(px&0xff00ff00)<<24;
+	return (spread * (3ull<<56 | 7ull<<40 | 5ull<<24 | 11ull<<8)) >> 56 & 63;
+}
+
+// TGAImage keeps BGR(A), a gray pixel is all three channels
+template<int bpp>
+inline uint32_t load_qoi_pixel(const unsigned char *p) {
+	if (bpp==1) return qoi_pack(p[0], p[0], p[0], 255);
+	if (bpp==3) return qoi_pack(p[2], p[1], p[0], 255);
+	return qoi_pack(p[2], p[1], p[0], p[3]);
+}
+
+template<int bpp>
+inline void store_qoi_pixel(unsigned char *p, uint32_t px) {
+	p[0] = px>>16;
+	p[1] = px>>8;
+	p[2] = px;
+	if (bpp==4) p[3] = px>>24;
+}
+
+inline void put_be32(unsigned char *p, uint32_t v) {
+	p[0] = v>>24; p[1] = v>>16; p[2] = v>>8; p[3] = v;
+}
+
+inline uint32_t get_be32(const unsigned char *p) {
+	return uint32_t(p[0])<<24 | uint32_t(p[1])<<16 | uint32_t(p[2])<<8 | p[3];
+}
+
+// Chunks go to a fixed block that is written out whenever it runs low, the encoded file is never held whole
+struct QOIStream {
+	// a pending run followed by the 8 byte store of a chunk is the most one pixel writes
+	static const unsigned long max_pixel_bytes = 9;
+
+	std::ofstream &out;
+	std::vector<unsigned char> block;
+
+	explicit QOIStream(std::ofstream &out) : out(out), block(1<<16) {}
+
+	unsigned char *begin() { return block.data(); }
+	// past this a pixel may not fit anymore
+	unsigned char *limit() { return block.data() + block.size() - max_pixel_bytes; }
+
+	bool flush(const unsigned char *end) {
+		out.write((char *)block.data(), end-block.data());
+		return out.good();
+	}
+};
+
+// QOI goes top to bottom, `row` is the top row and `row_step` the bytes to the next one down.
+// The output cursor lives in a local: stores through unsigned char pointers may alias anything, so the compiler
+// would reload the stream and the index from memory after each of them otherwise
+template<int bpp>
+bool encode_qoi(const unsigned char *row, long row_step, int width, int height, QOIStream &stream) {
+	uint32_t index[64] = {};
+	uint32_t prev = qoi_pack(0, 0, 0, 255);
+	int run = 0;
+	unsigned long left = (unsigned long)width*height;
+	unsigned char *dst = stream.begin();
+	unsigned char *const limit = stream.limit();
+	for (int y=0; y<height; y++, row+=row_step) {
+		const unsigned char *src = row;
+		for (int x=0; x<width; x++, src+=bpp) {
+			left--;
+			if (dst > limit) {
+				if (!stream.flush(dst)) return false;
+				dst = stream.begin();
+			}
+			const uint32_t px = load_qoi_pixel<bpp>(src);
+			if (px==prev) {
+				run++;
+				if (run==62 || !left) {
+					*dst++ = QOI_OP_RUN | (run-1);
+					run = 0;
+				}
+				continue;
+			}
+			if (run) {
+				*dst++ = QOI_OP_RUN | (run-1);
+				run = 0;
+			}
+			// On textured images the chunk that applies is close to random, so all of them are formed and the one to
+			// use is picked without branching: the kinds are numbered in order of preference, the largest one that fits
+			// wins. It is stored as one little endian 8 byte word of which only the chunk's length counts.
+			const unsigned h = qoi_hash(px);
+			const int vr = (signed char)((px&0xff) - (prev&0xff));
+			const int vg = (signed char)((px>>8&0xff) - (prev>>8&0xff));
+			const int vb = (signed char)((px>>16&0xff) - (prev>>16&0xff));
+			const int vg_r = (signed char)(vr - vg);
+			const int vg_b = (signed char)(vb - vg);
+			const unsigned diff = (unsigned(vr+2)<4) & (unsigned(vg+2)<4) & (unsigned(vb+2)<4);
+			const unsigned luma = (unsigned(vg+32)<64) & (unsigned(vg_r+8)<16) & (unsigned(vg_b+8)<16);
+			const unsigned rgba = (px^prev)>>24 != 0;
+			const unsigned indexed = index[h]==px;
+			const unsigned kind = std::max(std::max(indexed*4, rgba*3), std::max(diff*2, luma));
+			const uint64_t chunks[5] = {
+				QOI_OP_RGB | uint64_t(px&0xffffff)<<8,
+				uint64_t((QOI_OP_LUMA | (vg+32)) | ((vg_r+8)<<4 | (vg_b+8))<<8),
+				uint64_t(QOI_OP_DIFF | (vr+2)<<4 | (vg+2)<<2 | (vb+2)),
+				QOI_OP_RGBA | uint64_t(px)<<8,
+				uint64_t(QOI_OP_INDEX | h),
+			};
+			static const unsigned char chunk_size[5] = {4, 2, 1, 5, 1};
+			index[h] = px;
+			memcpy(dst, &chunks[kind], sizeof(uint64_t));
+			dst += chunk_size[kind];
+			prev = px;
 		}
-		out.write((char *)(data+chunkstart), (raw?run_length*bytespp:bytespp));
-		if (!out.good()) {
-			std::cerr << "can't dump the tga file\n";
-			return false;
+	}
+	return stream.flush(dst);
+}
+
+template<int bpp>
+bool decode_qoi(const unsigned char *in, const unsigned char *end, unsigned char *dst, unsigned long npixels) {
+	uint32_t index[64] = {};
+	uint32_t px = qoi_pack(0, 0, 0, 255);
+	for (unsigned long i=0; i<npixels; ) {
+		if (in==end) return false;
+		const unsigned char op = *in++;
+		unsigned long run = 1;
+		if (op==QOI_OP_RGB) {
+			if (end-in<3) return false;
+			px = qoi_pack(in[0], in[1], in[2], px>>24);
+			in += 3;
+		} else if (op==QOI_OP_RGBA) {
+			if (end-in<4) return false;
+			px = qoi_pack(in[0], in[1], in[2], in[3]);
+			in += 4;
+		} else if ((op&QOI_MASK_2)==QOI_OP_INDEX) {
+			px = index[op];
+		} else if ((op&QOI_MASK_2)==QOI_OP_DIFF) {
+			const unsigned r = (px + ((op>>4)&3) - 2) & 0xff;
+			const unsigned g = ((px>>8) + ((op>>2)&3) - 2) & 0xff;
+			const unsigned b = ((px>>16) + (op&3) - 2) & 0xff;
+			px = qoi_pack(r, g, b, px>>24);
+		} else if ((op&QOI_MASK_2)==QOI_OP_LUMA) {
+			if (in==end) return false;
+			const int vg = (op&0x3f) - 32;
+			const int vg_r = (*in>>4) - 8;
+			const int vg_b = (*in&0x0f) - 8;
+			in++;
+			const unsigned r = ((px&0xff) + vg + vg_r) & 0xff;
+			const unsigned g = ((px>>8&0xff) + vg) & 0xff;
+			const unsigned b = ((px>>16&0xff) + vg + vg_b) & 0xff;
+			px = qoi_pack(r, g, b, px>>24);
+		} else {
+			run = (op&0x3f) + 1;
+			if (run > npixels-i) return false;
 		}
+		index[qoi_hash(px)] = px;
+		for (unsigned long k=0; k<run; k++, dst+=bpp)
+			store_qoi_pixel<bpp>(dst, px);
+		i += run;
 	}
 	return true;
 }
 
+}
+
+bool TGAImage::read_qoi_file(const char *filename) {
+	if (data) delete [] data;
+	data = NULL;
+	MappedFile file;
+	if (!file.open(filename)) {
+		std::cerr << "can't open file " << filename << "\n";
+		return false;
+	}
+	file.will_need();
+	const unsigned char *in = file.data();
+	if (file.size() < qoi_header_size + sizeof(qoi_end_marker) || memcmp(in, qoi_magic, sizeof(qoi_magic))) {
+		std::cerr << "an error occured while reading the header\n";
+		return false;
+	}
+	const uint32_t w = get_be32(in+4);
+	const uint32_t h = get_be32(in+8);
+	const int channels = in[12];
+	if (w==0 || h==0 || h > qoi_pixels_max/w || (channels!=RGB && channels!=RGBA)) {
+		std::cerr << "bad bpp (or width/height) value\n";
+		return false;
+	}
+	width   = w;
+	height  = h;
+	bytespp = channels;
+	origin  = TOP_LEFT;
+	const unsigned long npixels = (unsigned long)width*height;
+	data = new unsigned char[npixels*bytespp];
+	// the end marker isn't looked for, the header says how many pixels there are
+	const unsigned char *chunks = in + qoi_header_size;
+	const unsigned char *end = in + file.size();
+	const bool ok = bytespp==RGB ? decode_qoi<3>(chunks, end, data, npixels) : decode_qoi<4>(chunks, end, data, npixels);
+	if (!ok) {
+		std::cerr << "an error occured while reading the data\n";
+		return false;
+	}
+	std::cerr << width << "x" << height << "/" << bytespp*8 << "\n";
+	return true;
+}
+
+bool TGAImage::write_qoi_file(const char *filename) {
+	std::ofstream out;
+	out.open (filename, std::ios::binary);
+	if (!out.is_open()) {
+		std::cerr << "can't open file " << filename << "\n";
+		out.close();
+		return false;
+	}
+	unsigned char header[qoi_header_size];
+	memcpy(header, qoi_magic, sizeof(qoi_magic));
+	put_be32(header+4, width);
+	put_be32(header+8, height);
+	header[12] = bytespp==RGBA ? 4 : 3;
+	header[13] = 0; // sRGB with linear alpha
+	out.write((char *)header, sizeof(header));
+	if (!out.good()) {
+		std::cerr << "can't dump the qoi file\n";
+		out.close();
+		return false;
+	}
+	QOIStream stream(out);
+	const long row_bytes = width*bytespp;
+	const unsigned char *top = origin==TOP_LEFT ? data : data + (height-1)*row_bytes;
+	const long row_step = origin==TOP_LEFT ? row_bytes : -row_bytes;
+	bool ok;
+	if (bytespp==GRAYSCALE)
+		ok = encode_qoi<1>(top, row_step, width, height, stream);
+	else if (bytespp==RGB)
+		ok = encode_qoi<3>(top, row_step, width, height, stream);
+	else
+		ok = encode_qoi<4>(top, row_step, width, height, stream);
+	if (!ok) {
+		std::cerr << "can't unload qoi data\n";
+		out.close();
+		return false;
+	}
+	out.write((char *)qoi_end_marker, sizeof(qoi_end_marker));
+	if (!out.good()) {
+		std::cerr << "can't dump the qoi file\n";
+		out.close();
+		return false;
+	}
+	out.close();
+	return true;
+}
+
 TGAColor TGAImage::get(int x, int y) {
 	if (!data || x<0 || y<0 || x>=width || y>=height) {
 		return TGAColor();
@@ -278,16 +740,117 @@ int TGAImage::get_height() {
 	return height;
 }
 
+namespace {
+
+#if defined(__SSE2__)
+// The 16 bytes in reverse order of whole pixels, for 1 and 4 bytes per pixel
+template<int bytespp>
+inline __m128i reverse_pixels(__m128i v) {
+	v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+	if (bytespp==1) {
+		v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+	}
+	return v;
+}
+
+// The 16 RGB pixels in the 48 bytes v0 v1 v2, in reverse order
+inline void reverse_rgb_pixels(__m128i &v0, __m128i &v1, __m128i &v2) {
+#if defined(__SSSE3__)
+	// every byte of the result comes from one of at most three registers, the others are masked out by -1
+	const __m128i r0 = _mm_or_si128(
+		_mm_shuffle_epi8(v2, _mm_setr_epi8(13, 14, 15, 10, 11, 12, 7, 8, 9, 4, 5, 6, 1, 2, 3, -1)),
+		_mm_shuffle_epi8(v1, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 14)));
+	const __m128i r1 = _mm_or_si128(_mm_or_si128(
+		_mm_shuffle_epi8(v1, _mm_setr_epi8(15, -1, 11, 12, 13, 8, 9, 10, 5, 6, 7, 2, 3, 4, -1, 0)),
+		_mm_shuffle_epi8(v2, _mm_setr_epi8(-1, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1))),
+		_mm_shuffle_epi8(v0, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 15, -1)));
+	const __m128i r2 = _mm_or_si128(
+		_mm_shuffle_epi8(v0, _mm_setr_epi8(-1, 12, 13, 14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2)),
+		_mm_shuffle_epi8(v1, _mm_setr_epi8(1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)));
+#else
+	// Reversing the 48 bytes reverses the pixels and the bytes within each. Byte k of the block then takes byte
+	// k+2 when k%3==0 and byte k-2 when k%3==2, the whole block shifted by 2 bytes either way.
+	const __m128i b0 = reverse_pixels<1>(v2);
+	const __m128i b1 = reverse_pixels<1>(v1);
+	const __m128i b2 = reverse_pixels<1>(v0);
+	const __m128i next0 = _mm_or_si128(_mm_srli_si128(b0, 2), _mm_slli_si128(b1, 14));
+	const __m128i next1 = _mm_or_si128(_mm_srli_si128(b1, 2), _mm_slli_si128(b2, 14));
+	const __m128i next2 = _mm_srli_si128(b2, 2);
+	const __m128i prev0 = _mm_slli_si128(b0, 2);
+	const __m128i prev1 = _mm_or_si128(_mm_slli_si128(b1, 2), _mm_srli_si128(b0, 14));
+	const __m128i prev2 = _mm_or_si128(_mm_slli_si128(b2, 2), _mm_srli_si128(b1, 14));
+	// every third byte of a register from its first, second and third one on; the block's registers start at
+	// k%3 = 0, 1 and 2
+	const __m128i m0 = _mm_setr_epi8(-1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1);
+	const __m128i m1 = _mm_setr_epi8(0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0);
+	const __m128i m2 = _mm_setr_epi8(0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0);
+	const __m128i r0 = _mm_or_si128(_mm_or_si128(_mm_and_si128(next0, m0), _mm_and_si128(b0, m1)), _mm_and_si128(prev0, m2));
+	const __m128i r1 = _mm_or_si128(_mm_or_si128(_mm_and_si128(next1, m2), _mm_and_si128(b1, m0)), _mm_and_si128(prev1, m1));
+	const __m128i r2 = _mm_or_si128(_mm_or_si128(_mm_and_si128(next2, m1), _mm_and_si128(b2, m2)), _mm_and_si128(prev2, m0));
+#endif
+	v0 = r0;
+	v1 = r1;
+	v2 = r2;
+}
+#endif
+
+// Reverses the pixels of one row in place. Blocks from either end are swapped and reversed in registers, 16 bytes
+// at a time or 48 for RGB (16 bytes aren't whole RGB pixels); what's left in the middle goes pixel by pixel.
+template<int bytespp>
+void reverse_row(unsigned char *row, int width) {
+	unsigned char *lo = row;
+	unsigned char *hi = row + width*bytespp;
+#if defined(__SSE2__)
+	if (bytespp==3) {
+		for (; hi-lo>=96; lo+=48) {
+			hi -= 48;
+			__m128i a0 = _mm_loadu_si128((const __m128i *)lo);
+			__m128i a1 = _mm_loadu_si128((const __m128i *)(lo+16));
+			__m128i a2 = _mm_loadu_si128((const __m128i *)(lo+32));
+			__m128i b0 = _mm_loadu_si128((const __m128i *)hi);
+			__m128i b1 = _mm_loadu_si128((const __m128i *)(hi+16));
+			__m128i b2 = _mm_loadu_si128((const __m128i *)(hi+32));
+			reverse_rgb_pixels(a0, a1, a2);
+			reverse_rgb_pixels(b0, b1, b2);
+			_mm_storeu_si128((__m128i *)lo, b0);
+			_mm_storeu_si128((__m128i *)(lo+16), b1);
+			_mm_storeu_si128((__m128i *)(lo+32), b2);
+			_mm_storeu_si128((__m128i *)hi, a0);
+			_mm_storeu_si128((__m128i *)(hi+16), a1);
+			_mm_storeu_si128((__m128i *)(hi+32), a2);
+		}
+	} else {
+		for (; hi-lo>=32; lo+=16) {
+			hi -= 16;
+			const __m128i a = _mm_loadu_si128((const __m128i *)lo);
+			const __m128i b = _mm_loadu_si128((const __m128i *)hi);
+			_mm_storeu_si128((__m128i *)lo, reverse_pixels<bytespp>(b));
+			_mm_storeu_si128((__m128i *)hi, reverse_pixels<bytespp>(a));
+		}
+	}
+#endif
+	unsigned char pixel[bytespp];
+	for (hi-=bytespp; lo<hi; lo+=bytespp, hi-=bytespp) {
+		memcpy(pixel, lo, bytespp);
+		memcpy(lo, hi, bytespp);
+		memcpy(hi, pixel, bytespp);
+	}
+}
+
+}
+
 bool TGAImage::flip_horizontally() {
 	if (!data) return false;
-	int half = width>>1;
-	for (int i=0; i<half; i++) {
-		for (int j=0; j<height; j++) {
-			TGAColor c1 = get(i, j);
-			TGAColor c2 = get(width-1-i, j);
-			set(i, j, c2);
-			set(width-1-i, j, c1);
-		}
+	const unsigned long bytes_per_line = width*bytespp;
+	for (int j=0; j<height; j++) {
+		unsigned char *row = data + j*bytes_per_line;
+		if (bytespp==GRAYSCALE)
+			reverse_row<1>(row, width);
+		else if (bytespp==RGB)
+			reverse_row<3>(row, width);
+		else
+			reverse_row<4>(row, width);
 	}
 	return true;
 }
@@ -316,38 +879,12 @@ void TGAImage::clear() {
 	memset((void *)data, 0, width*height*bytespp);
 }
 
+// Lanczos resampled, see resample.hpp for the other filters and for reusing the weights across images
 bool TGAImage::scale(int w, int h) {
 	if (w<=0 || h<=0 || !data) return false;
-	unsigned char *tdata = new unsigned char[w*h*bytespp];
-	int nscanline = 0;
-	int oscanline = 0;
-	int erry = 0;
-	unsigned long nlinebytes = w*bytespp;
-	unsigned long olinebytes = width*bytespp;
-	for (int j=0; j<height; j++) {
-		int errx = width-w;
-		int nx   = -bytespp;
-		int ox   = -bytespp;
-		for (int i=0; i<width; i++) {
-			ox += bytespp;
-			errx += w;
-			while (errx>=(int)width) {
-				errx -= width;
-				nx += bytespp;
-				memcpy(tdata+nscanline+nx, data+oscanline+ox, bytespp);
-			}
-		}
-		erry += h;
-		oscanline += olinebytes;
-		while (erry>=(int)height) {
-			if (erry>=(int)height<<1) // it means we jump over a scanline
-				memcpy(tdata+nscanline+nlinebytes, tdata+nscanline, nlinebytes);
-			erry -= height;
-			nscanline += nlinebytes;
-		}
-	}
-	delete [] data;
-	data = tdata;
+	TGAImage scaled(w, h, bytespp, origin);
+	Resampler(width, height, w, h).resample(*this, scaled);
+	std::swap(data, scaled.data);
 	width = w;
 	height = h;
 	return true;
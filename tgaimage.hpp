@@ -16,8 +16,8 @@ protected:
   int height;
   int bytespp;
 
-  bool load_rle_data(std::ifstream& in);
-  bool unload_rle_data(std::ofstream& out);
+  bool load_rle_data(const unsigned char* in, unsigned long size);
+  bool unload_rle_data(std::ofstream& out, bool parallel);
 
 public:
   enum Format {
@@ -26,11 +26,28 @@ public:
     RGBA = 4
   };
 
+  // The corner the first stored row starts at. get/set and buffer() address rows as they are stored, and files
+  // are written with the origin in their descriptor, so nothing has to be flipped to load or save an image.
+  enum Origin {
+    // the TGA default, and how the renderer fills images: y goes up
+    BOTTOM_LEFT,
+    TOP_LEFT
+  };
+
   TGAImage();
-  TGAImage(int w, int h, int bpp);
+  TGAImage(int w, int h, int bpp, Origin origin = TOP_LEFT);
   TGAImage(const TGAImage& img);
   bool read_tga_file(const char* filename);
-  bool write_tga_file(const char* filename, bool rle = true);
+  // `parallel` encodes bands of rows on all hardware threads, the file is byte for byte the same
+  bool write_tga_file(const char* filename, bool rle = true, bool parallel = false);
+  bool read_qoi_file(const char* filename);
+  // QOI only has 3 and 4 channel images, GRAYSCALE is stored (and read back) as RGB
+  bool write_qoi_file(const char* filename);
+  Origin get_origin() const { return origin; }
+  void set_origin(Origin o) { origin = o; }
+  // Stored row of the row `y` counted from the bottom of the picture, e.g. where a texture coordinate v points
+  int row_from_bottom(int y) const { return origin == BOTTOM_LEFT ? y : height - 1 - y; }
+  // Both move the pixels, the origin stays
   bool flip_horizontally();
   bool flip_vertically();
   bool scale(int w, int h);
@@ -46,6 +63,9 @@ public:
 
   TGAImage& line(int x0, int y0, int x1, int y1, const TGAColor color);
   TGAImage& line(glm::vec2 a, glm::vec2 b, const TGAColor color);
+
+protected:
+  Origin origin;
 };
 
 #endif //__IMAGE_H__
\ No newline at end of file
@@ -0,0 +1,281 @@
+#pragma once
+
+#include "hierarchical_z.hpp"
+#include "parallel.hpp"
+#include "rasterization.hpp"
+#include "shaders.hpp"
+#include "tgaimage.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Sort-middle rasterizer: screen space triangles are binned into fixed size tiles on submit,
+// then every tile is rasterized on its own thread. A tile only writes its own slice of the
+// color and depth buffers so no locking is needed, and triangles keep their submission order
+// within a tile so the result is the same as rasterizing them one by one.
+// Each triangle is tested against a hierarchical z first, hidden ones are skipped per tile, and large ones also per
+// 8x8 block (see HIZ_MIN_BLOCKS).
+// With DEFERRED shading a tile is first rasterized into depth and triangle ids only (a visibility buffer),
+// then every visible pixel is shaded exactly once, so overdraw no longer multiplies texture fetches.
+class TileRasterizer {
+public:
+  enum Mode {
+    FLOATING_POINT,
+    // 28.4 sub-pixel vertices, integer edge functions and a top-left fill rule, see setup_triangle_fixed
+    FIXED_POINT
+  };
+
+  enum Shading {
+    FORWARD,
+    DEFERRED
+  };
+
+  static constexpr uint32_t NO_TRIANGLE = std::numeric_limits<uint32_t>::max();
+
+  struct Triangle {
+    std::array<glm::vec3, 3> screen_coords;
+    std::array<glm::vec2, 3> texcoords;
+    float_t light_intensity;
+    // mip level of a DEFERRED resolve, set up with the triangle's edge functions in flush
+    float_t lod = 0;
+  };
+
+  // Triangles whose bounds cover fewer 8x8 blocks of a tile than this skip the per block depth tests, see flush
+  static constexpr int HIZ_MIN_BLOCKS = 32;
+
+  // `tile_size` has to be a multiple of HierarchicalZ::BLOCK_SIZE and at most 64 blocks.
+  // `hiz_min_blocks` of 0 tests every triangle block by block, one above the blocks of a tile only tests whole tiles.
+  TileRasterizer(int width, int height, Mode mode = FLOATING_POINT, Shading shading = FORWARD, int tile_size = 64, int hiz_min_blocks = HIZ_MIN_BLOCKS)
+    : mode(mode)
+    , shading(shading)
+    , width(width)
+    , height(height)
+    , tile_size(tile_size)
+    , hiz_min_blocks(hiz_min_blocks)
+    , tiles_x((width + tile_size - 1) / tile_size)
+    , tiles_y((height + tile_size - 1) / tile_size)
+    , bins(tiles_x * tiles_y)
+    , hiz(width, height, tile_size) {
+    if (shading == DEFERRED)
+      ids.resize(width * height);
+  }
+
+  void submit(std::array<glm::vec3, 3> screen_coords, const std::array<glm::vec2, 3>& texcoords, float_t light_intensity) {
+    // snap up front so the bins are computed from the same coordinates the fixed point setup sees
+    if (mode == FIXED_POINT) {
+      for (auto& p : screen_coords) {
+        p.x = to_fixed(p.x) / float_t(SUBPIXEL_ONE);
+        p.y = to_fixed(p.y) / float_t(SUBPIXEL_ONE);
+      }
+    }
+
+    const glm::vec2 clamp_min{ 0, 0 };
+    const glm::vec2 clamp_max{ width - 1, height - 1 };
+    auto [min, max] = bbox(screen_coords, clamp_min, clamp_max);
+    if (min.x > max.x || min.y > max.y)
+      return;
+
+    const uint32_t index = triangles.size();
+    triangles.push_back(Triangle{ screen_coords, texcoords, light_intensity });
+
+    const int tile_min_x = int(min.x) / tile_size;
+    const int tile_min_y = int(min.y) / tile_size;
+    const int tile_max_x = int(max.x) / tile_size;
+    const int tile_max_y = int(max.y) / tile_size;
+    for (int ty = tile_min_y; ty <= tile_max_y; ++ty)
+      for (int tx = tile_min_x; tx <= tile_max_x; ++tx)
+        bins[tx + ty * tiles_x].push_back(index);
+  }
+
+  // Rasterizes everything submitted so far and empties the bins, `texture` is a TGAImage or a Texture2D
+  template<class Texture>
+  void flush(std::vector<float_t>& z_buffer, TGAImage& image, Texture& texture) {
+    constexpr int block_size = HierarchicalZ::BLOCK_SIZE;
+    hiz.invalidate();
+
+    // the resolve pass needs every triangle's edge functions over the whole screen and its mip level, set them up once
+    if (shading == DEFERRED) {
+      const glm::ivec2 screen_min{ 0, 0 };
+      const glm::ivec2 screen_max{ width - 1, height - 1 };
+      if (mode == FIXED_POINT) {
+        fixed_setups.resize(triangles.size());
+        parallel_for(triangles.size(), [&](size_t i) {
+          fixed_setups[i] = setup_triangle_fixed(triangles[i].screen_coords, screen_min, screen_max);
+          triangles[i].lod = texture_lod(texture, fixed_setups[i], triangles[i].texcoords);
+        });
+      } else {
+        setups.resize(triangles.size());
+        parallel_for(triangles.size(), [&](size_t i) {
+          setups[i] = setup_triangle(triangles[i].screen_coords, screen_min, screen_max);
+          triangles[i].lod = texture_lod(texture, setups[i], triangles[i].texcoords);
+        });
+      }
+    }
+
+    parallel_for(bins.size(), [&](size_t tile) {
+      const int tx = tile % tiles_x;
+      const int ty = tile / tiles_x;
+      const glm::ivec2 tile_min{ tx * tile_size, ty * tile_size };
+      const glm::ivec2 tile_max{ std::min((tx + 1) * tile_size, width) - 1, std::min((ty + 1) * tile_size, height) - 1 };
+
+      if (shading == DEFERRED) {
+        for (int y = tile_min.y; y <= tile_max.y; ++y)
+          std::fill(ids.begin() + tile_min.x + y * width, ids.begin() + tile_max.x + 1 + y * width, NO_TRIANGLE);
+      }
+
+      for (uint32_t index : bins[tile]) {
+        Triangle& t = triangles[index];
+        auto& [a, b, c] = t.screen_coords;
+        // interpolated depth can overshoot the vertices by a few ulps, keep the bound conservative
+        float_t nearest = std::max({ a.z, b.z, c.z });
+        nearest += std::abs(nearest) * 4 * std::numeric_limits<float_t>::epsilon();
+        if (hiz.occluded_tile(tx, ty, nearest))
+          continue;
+
+        auto [min, max] = bbox(t.screen_coords, tile_min, tile_max);
+        const int bx_begin = int(std::ceil(min.x)) / block_size;
+        const int by_begin = int(std::ceil(min.y)) / block_size;
+        const int bx_end = int(max.x) / block_size;
+        const int by_end = int(max.y) / block_size;
+
+        // a small triangle costs less to rasterize than to test block by block, it only has to mark its blocks
+        if ((bx_end - bx_begin + 1) * (by_end - by_begin + 1) < hiz_min_blocks) {
+          for (int by = by_begin; by <= by_end; ++by)
+            for (int bx = bx_begin; bx <= bx_end; ++bx)
+              hiz.touched(bx, by, nearest);
+          raster(index, z_buffer, image, texture, tile_min, tile_max);
+          continue;
+        }
+
+        // visible blocks of a block row are merged into runs so the triangle is set up once per run,
+        // and only once when nothing was rejected
+        std::array<uint64_t, 64> rows{};
+        bool rejected = false;
+        for (int by = by_begin; by <= by_end; ++by) {
+          for (int bx = bx_begin; bx <= bx_end; ++bx) {
+            if (hiz.occluded_block(bx, by, nearest, z_buffer)) {
+              rejected = true;
+            } else {
+              rows[by - by_begin] |= uint64_t(1) << (bx - bx_begin);
+              hiz.touched(bx, by, nearest);
+            }
+          }
+        }
+
+        if (!rejected) {
+          raster(index, z_buffer, image, texture, tile_min, tile_max);
+          continue;
+        }
+        for (int by = by_begin; by <= by_end; ++by) {
+          for (uint64_t row = rows[by - by_begin]; row;) {
+            const int first = std::countr_zero(row);
+            const int count = std::countr_one(row >> first);
+            row &= ~(((count == 64 ? 0 : uint64_t(1) << count) - 1) << first);
+
+            const glm::ivec2 run_min{ (bx_begin + first) * block_size, by * block_size };
+            const glm::ivec2 run_max{ std::min((bx_begin + first + count) * block_size - 1, tile_max.x), std::min((by + 1) * block_size - 1, tile_max.y) };
+            raster(index, z_buffer, image, texture, run_min, run_max);
+          }
+        }
+      }
+
+      if (shading == DEFERRED)
+        resolve(tile_min, tile_max, image, texture);
+    });
+
+    triangles.clear();
+    for (auto& bin : bins)
+      bin.clear();
+  }
+
+  // True when nothing inside the screen rectangle [min, max] that is no nearer than `nearest` can pass the depth test
+  // against the z_buffer as the last flush left it, so a whole object can be skipped before its vertices are even
+  // transformed. Must not be called during a flush.
+  bool occluded(glm::vec2 min, glm::vec2 max, float_t nearest, const std::vector<float_t>& z_buffer) {
+    constexpr int block_size = HierarchicalZ::BLOCK_SIZE;
+    const glm::ivec2 screen_max{ width - 1, height - 1 };
+    const glm::ivec2 rect_min = glm::clamp(glm::ivec2(glm::floor(min)), glm::ivec2(0), screen_max);
+    const glm::ivec2 rect_max = glm::clamp(glm::ivec2(glm::ceil(max)), glm::ivec2(0), screen_max);
+    if (max.x < 0 || max.y < 0 || min.x > screen_max.x || min.y > screen_max.y)
+      return true;
+
+    nearest += std::abs(nearest) * 4 * std::numeric_limits<float_t>::epsilon();
+    for (int ty = rect_min.y / tile_size; ty <= rect_max.y / tile_size; ++ty) {
+      for (int tx = rect_min.x / tile_size; tx <= rect_max.x / tile_size; ++tx) {
+        if (hiz.occluded_tile(tx, ty, nearest))
+          continue;
+        const int bx_begin = std::max(rect_min.x, tx * tile_size) / block_size;
+        const int by_begin = std::max(rect_min.y, ty * tile_size) / block_size;
+        const int bx_end = std::min(rect_max.x, (tx + 1) * tile_size - 1) / block_size;
+        const int by_end = std::min(rect_max.y, (ty + 1) * tile_size - 1) / block_size;
+        for (int by = by_begin; by <= by_end; ++by)
+          for (int bx = bx_begin; bx <= bx_end; ++bx)
+            if (!hiz.occluded_block(bx, by, nearest, z_buffer))
+              return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  template<class Texture>
+  void raster(uint32_t index, std::vector<float_t>& z_buffer, TGAImage& image, Texture& texture, glm::ivec2 clamp_min, glm::ivec2 clamp_max) {
+    Triangle& t = triangles[index];
+    if (shading == DEFERRED) {
+      if (mode == FIXED_POINT)
+        raster_triangle_visibility_fixed(t.screen_coords, index, z_buffer, ids, width, clamp_min, clamp_max);
+      else
+        raster_triangle_visibility(t.screen_coords, index, z_buffer, ids, width, clamp_min, clamp_max);
+    } else {
+      if (mode == FIXED_POINT)
+        raster_triangle_with_depth_buffer_fixed(t.screen_coords, t.texcoords, z_buffer, image, texture, t.light_intensity, clamp_min, clamp_max);
+      else
+        raster_triangle_with_depth_buffer(t.screen_coords, t.texcoords, z_buffer, image, texture, t.light_intensity, clamp_min, clamp_max);
+    }
+  }
+
+  // Shades every pixel of the tile that ended up with a triangle id, barycentrics are recomputed from the
+  // triangle's edge functions
+  template<class Texture>
+  void resolve(glm::ivec2 tile_min, glm::ivec2 tile_max, TGAImage& image, Texture& texture) {
+    for (int y = tile_min.y; y <= tile_max.y; ++y) {
+      for (int x = tile_min.x; x <= tile_max.x; ++x) {
+        const uint32_t index = ids[x + y * width];
+        if (index == NO_TRIANGLE)
+          continue;
+
+        Triangle& t = triangles[index];
+        glm::vec3 bc;
+        if (mode == FIXED_POINT) {
+          const auto edge = edge_values_at(fixed_setups[index], x, y);
+          bc = glm::vec3(edge[0], edge[1], edge[2]) * fixed_setups[index].inv_area;
+        } else {
+          bc = edge_values_at(setups[index], x, y) * setups[index].inv_area;
+        }
+        image.set(x, y, shade_textured(texture, t.texcoords, bc, t.light_intensity, t.lod));
+      }
+    }
+  }
+
+  Mode mode;
+  Shading shading;
+  int width;
+  int height;
+  int tile_size;
+  int hiz_min_blocks;
+  int tiles_x;
+  int tiles_y;
+  std::vector<Triangle> triangles;
+  std::vector<std::vector<uint32_t>> bins;
+  HierarchicalZ hiz;
+  std::vector<uint32_t> ids;
+  std::vector<TriangleSetup> setups;
+  std::vector<FixedTriangleSetup> fixed_setups;
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "obj_loader_helper.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Structure of arrays position stream, one lane per vertex in the SIMD transform
+struct PositionStream {
+  std::vector<float_t> x;
+  std::vector<float_t> y;
+  std::vector<float_t> z;
+
+  size_t size() const { return x.size(); }
+};
+
+inline PositionStream make_position_stream(const IndexedMesh& mesh) {
+  const size_t count = mesh.vertex_count();
+  PositionStream stream{};
+  stream.x.resize(count);
+  stream.y.resize(count);
+  stream.z.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    stream.x[i] = mesh.attrib.vertices[3 * i + 0];
+    stream.y[i] = mesh.attrib.vertices[3 * i + 1];
+    stream.z[i] = mesh.attrib.vertices[3 * i + 2];
+  }
+  return stream;
+}
+
+// Maps normalized device coordinates to pixels after the perspective divide: screen = ndc * scale + offset.
+struct Viewport {
+  glm::vec2 scale;
+  glm::vec2 offset;
+};
+
+// The mapping of world_to_screen, without its snap to whole pixels
+inline Viewport make_viewport(size_t width, size_t height) {
+  const size_t width_half = width / 2;
+  const float_t aspect_ratio = width < height ? height / float(width) : width / float(height);
+  return Viewport{ { aspect_ratio * width_half, width_half }, { width_half, width_half } };
+}
+
+// Screen coordinates of a clip space position, z is 1/w: linear in screen space and growing towards the viewer
+// like the z_buffer expects. Same operations in the same order as transform_vertices, so the results match bit for
+// bit and clipped triangles share their edges exactly with unclipped ones.
+inline glm::vec3 clip_to_screen(glm::vec4 clip, const Viewport& viewport) {
+  const float_t inv_w = 1.0f / clip.w;
+  return glm::vec3(clip.x * inv_w * viewport.scale.x + viewport.offset.x, clip.y * inv_w * viewport.scale.y + viewport.offset.y, inv_w);
+}
+
+// Post-transform vertex buffer written by transform_vertices, structure of arrays like the input. The vertex stage
+// runs once per unique position of a mesh, triangles then fetch their corners by `index_t::vertex_index`.
+struct VertexStream {
+  std::vector<float_t> clip_x;
+  std::vector<float_t> clip_y;
+  std::vector<float_t> clip_z;
+  std::vector<float_t> clip_w;
+  std::vector<float_t> screen_x;
+  std::vector<float_t> screen_y;
+  std::vector<float_t> screen_z;
+
+  void resize(size_t count) {
+    for (auto* stream : { &clip_x, &clip_y, &clip_z, &clip_w, &screen_x, &screen_y, &screen_z })
+      stream->resize(count);
+  }
+
+  glm::vec4 clip(size_t i) const { return glm::vec4(clip_x[i], clip_y[i], clip_z[i], clip_w[i]); }
+  glm::vec3 screen(size_t i) const { return glm::vec3(screen_x[i], screen_y[i], screen_z[i]); }
+};
+
+// Batch vertex stage: clip = mvp * (x, y, z, 1) and the screen coordinates of clip_to_screen for the positions
+// [first, first + count), 8 vertices per iteration with AVX2 and 4 with SSE2. `out` keeps the indices of `positions`,
+// entries outside of the range are left alone. `mvp` is the whole model-view-projection product, multiplied out once
+// by the caller. Screen coordinates of vertices behind the eye are meaningless, clip those triangles first.
+inline void transform_vertices(const PositionStream& positions, size_t first, size_t count, const glm::mat4& mvp, const Viewport& viewport, VertexStream& out) {
+  if (out.clip_x.size() < positions.size())
+    out.resize(positions.size());
+  const size_t end = first + count;
+
+  const float_t* px = positions.x.data();
+  const float_t* py = positions.y.data();
+  const float_t* pz = positions.z.data();
+  float_t* clip[4] = { out.clip_x.data(), out.clip_y.data(), out.clip_z.data(), out.clip_w.data() };
+
+  size_t i = first;
+#if defined(__AVX2__)
+  __m256 m[4][4];
+  for (int row = 0; row < 4; ++row)
+    for (int col = 0; col < 4; ++col)
+      m[row][col] = _mm256_set1_ps(mvp[col][row]);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 scale_x = _mm256_set1_ps(viewport.scale.x);
+  const __m256 scale_y = _mm256_set1_ps(viewport.scale.y);
+  const __m256 offset_x = _mm256_set1_ps(viewport.offset.x);
+  const __m256 offset_y = _mm256_set1_ps(viewport.offset.y);
+
+  for (; i + 8 <= end; i += 8) {
+    const __m256 x = _mm256_loadu_ps(px + i);
+    const __m256 y = _mm256_loadu_ps(py + i);
+    const __m256 z = _mm256_loadu_ps(pz + i);
+
+    __m256 c[4];
+    for (int row = 0; row < 4; ++row) {
+      c[row] = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m[row][0], x), _mm256_mul_ps(m[row][1], y)), _mm256_mul_ps(m[row][2], z)), m[row][3]);
+      _mm256_storeu_ps(clip[row] + i, c[row]);
+    }
+
+    const __m256 inv_w = _mm256_div_ps(one, c[3]);
+    _mm256_storeu_ps(out.screen_x.data() + i, _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(c[0], inv_w), scale_x), offset_x));
+    _mm256_storeu_ps(out.screen_y.data() + i, _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(c[1], inv_w), scale_y), offset_y));
+    _mm256_storeu_ps(out.screen_z.data() + i, inv_w);
+  }
+#elif defined(__SSE2__)
+  __m128 m[4][4];
+  for (int row = 0; row < 4; ++row)
+    for (int col = 0; col < 4; ++col)
+      m[row][col] = _mm_set1_ps(mvp[col][row]);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 scale_x = _mm_set1_ps(viewport.scale.x);
+  const __m128 scale_y = _mm_set1_ps(viewport.scale.y);
+  const __m128 offset_x = _mm_set1_ps(viewport.offset.x);
+  const __m128 offset_y = _mm_set1_ps(viewport.offset.y);
+
+  for (; i + 4 <= end; i += 4) {
+    const __m128 x = _mm_loadu_ps(px + i);
+    const __m128 y = _mm_loadu_ps(py + i);
+    const __m128 z = _mm_loadu_ps(pz + i);
+
+    __m128 c[4];
+    for (int row = 0; row < 4; ++row) {
+      c[row] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[row][0], x), _mm_mul_ps(m[row][1], y)), _mm_mul_ps(m[row][2], z)), m[row][3]);
+      _mm_storeu_ps(clip[row] + i, c[row]);
+    }
+
+    const __m128 inv_w = _mm_div_ps(one, c[3]);
+    _mm_storeu_ps(out.screen_x.data() + i, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(c[0], inv_w), scale_x), offset_x));
+    _mm_storeu_ps(out.screen_y.data() + i, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(c[1], inv_w), scale_y), offset_y));
+    _mm_storeu_ps(out.screen_z.data() + i, inv_w);
+  }
+#endif
+
+  // tail, and everything without SIMD
+  for (; i < end; ++i) {
+    glm::vec4 c;
+    for (int row = 0; row < 4; ++row)
+      c[row] = mvp[0][row] * px[i] + mvp[1][row] * py[i] + mvp[2][row] * pz[i] + mvp[3][row];
+    for (int row = 0; row < 4; ++row)
+      clip[row][i] = c[row];
+
+    const glm::vec3 screen = clip_to_screen(c, viewport);
+    out.screen_x[i] = screen.x;
+    out.screen_y[i] = screen.y;
+    out.screen_z[i] = screen.z;
+  }
+}
+
+inline void transform_vertices(const PositionStream& positions, const glm::mat4& mvp, const Viewport& viewport, VertexStream& out) {
+  out.resize(positions.size());
+  transform_vertices(positions, 0, positions.size(), mvp, viewport, out);
+}